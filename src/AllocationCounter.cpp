@@ -0,0 +1,101 @@
+//
+//  AllocationCounter.cpp
+//  visual-soundfx-test2
+//
+
+#include "AllocationCounter.hpp"
+#include "ofMain.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if ALLOCATION_COUNTING
+namespace {
+    std::atomic<uint64_t> allocationCount{0};
+    std::atomic<uint64_t> allocationBytes{0};
+    thread_local uint64_t threadAllocations = 0;
+
+    void* countedAlloc(std::size_t size) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+        threadAllocations++;
+        return std::malloc(size ? size : 1);
+    }
+}
+
+uint64_t AllocationCounter::getCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::getBytes() {
+    return allocationBytes.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::getThreadCount() {
+    return threadAllocations;
+}
+#else
+uint64_t AllocationCounter::getCount() {
+    return 0;
+}
+
+uint64_t AllocationCounter::getBytes() {
+    return 0;
+}
+
+uint64_t AllocationCounter::getThreadCount() {
+    return 0;
+}
+#endif
+
+void AllocationCounter::reportAllocations(const char *name, uint64_t count) {
+    ofLogError("AllocationCounter") << name << " allocated " << count << " times after warming up";
+    assert(count == 0 && "allocation in an ALLOCATION_FREE_SCOPE");
+}
+
+#if ALLOCATION_COUNTING
+// Plain, array and nothrow new/delete (aligned new isn't counted)
+void* operator new(std::size_t size) {
+    void* pointer = countedAlloc(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size) {
+    void* pointer = countedAlloc(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return countedAlloc(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+#endif
@@ -0,0 +1,76 @@
+//
+//  AllocationCounter.hpp
+//  visual-soundfx-test2
+//
+//  Counts heap allocations made through operator new (every thread, and per thread), for
+//  checking that the per-frame paths don't allocate. The replacement operators live in
+//  AllocationCounter.cpp and only add a couple of increments to each allocation.
+//
+//  They're only built into debug builds. Define ALLOCATION_COUNTING=1 to keep them in a
+//  release build (e.g. for the --benchmark allocs/frame column), or =0 to leave them out of a
+//  debug one. Without them every count reads 0 and isCounting() is false.
+//
+//  ALLOCATION_FREE_SCOPE("name") marks a block that shouldn't allocate once warmed up - in
+//  debug builds any allocation on this thread inside it, after its first warmupRuns passes,
+//  is logged and asserted. Compiles to nothing with NDEBUG or without counting.
+//
+
+#pragma once
+
+#include <cstdint>
+
+#ifndef ALLOCATION_COUNTING
+#ifdef NDEBUG
+#define ALLOCATION_COUNTING 0
+#else
+#define ALLOCATION_COUNTING 1
+#endif
+#endif
+
+class AllocationCounter {
+public:
+    static constexpr bool isCounting() { return ALLOCATION_COUNTING; }
+    static uint64_t getCount();     // allocations since startup
+    static uint64_t getBytes();     // bytes requested since startup
+    static uint64_t getThreadCount(); // allocations made by the calling thread
+
+    // Difference between two points in time, e.g. around one frame
+    struct Snapshot {
+        uint64_t count;
+        uint64_t bytes;
+    };
+    static Snapshot snapshot() { return {getCount(), getBytes()}; }
+
+    // Passes through a scope allowed to allocate, for one-off setup on first use. The count is
+    // per call site and shared by every instance, so anything sized per instance or per frame
+    // size has to be sized before the scope, not inside it
+    static const int warmupRuns = 120;
+
+    class Check {
+    public:
+        Check(const char *_name, int &_runs) : name(_name), runs(_runs), start(getThreadCount()) {}
+        ~Check() {
+            if (++runs <= warmupRuns) return;
+            uint64_t made = getThreadCount() - start;
+            if (made > 0) reportAllocations(name, made);
+        }
+    private:
+        const char *name;
+        int &runs;
+        uint64_t start;
+    };
+
+private:
+    static void reportAllocations(const char *name, uint64_t count);
+};
+
+#define ALLOCATION_CONCAT_INNER(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_INNER(a, b)
+
+#if ALLOCATION_COUNTING && !defined(NDEBUG)
+#define ALLOCATION_FREE_SCOPE(name) \
+    static int ALLOCATION_CONCAT(allocationRuns, __LINE__) = 0; \
+    AllocationCounter::Check ALLOCATION_CONCAT(allocationCheck, __LINE__)(name, ALLOCATION_CONCAT(allocationRuns, __LINE__))
+#else
+#define ALLOCATION_FREE_SCOPE(name)
+#endif
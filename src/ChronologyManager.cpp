@@ -1,11 +1,25 @@
 #include "ChronologyManager.hpp"
+#include "FrameProfiler.hpp"
 
 
 void ChronologyManager::setup() {
+    setupStartTime = ofGetElapsedTimeMillis();
+    
+    // Decoders are opened on the loader thread, only for clips near the playhead
+    clipLoader.setup();
+    loopCache.setLoopDuration(loopDuration);
+    loopCache.setMemoryBudget(loopCacheBudget * 1024 * 1024);
+    
     // Load JSON
     ofFile file("footage.json");
     if (file.exists()) {
         ofJson json = ofLoadJson(file);
+        if (json.contains("preload_window")) {
+            setPreloadWindow(json["preload_window"]);
+        }
+        if (json.contains("loop_cache_mb")) {
+            setLoopCacheBudget(json["loop_cache_mb"].get<size_t>());
+        }
         // Iterate through each topic defined in the JSON
         for (const auto& topicJson : json["topics"]) {
             Topic topic;
@@ -14,16 +28,12 @@ void ChronologyManager::setup() {
             // Load anchor point
             topic.anchor.videoPath = topicJson["anchor_points"][0]["video_path"];
             topic.anchor.description = topicJson["anchor_points"][0]["description"];
-            topic.anchor.video.load(topic.anchor.videoPath);
-            topic.anchor.video.setLoopState(OF_LOOP_NONE); // Play anchor once
 
             // Load all associated footage clips for the topic
             for (const auto& footageJson : topicJson["footage"]) {
                 Clip clip;
                 clip.videoPath = footageJson["video_path"];
                 clip.description = footageJson["description"];
-                clip.video.load(clip.videoPath);
-                clip.video.setLoopState(OF_LOOP_NORMAL); // Loop footage videos indefinitely
                 topic.footage.push_back(clip);
             }
 
@@ -48,17 +58,17 @@ void ChronologyManager::setup() {
             clip.id = entry["id"];
             clip.file = entry["file"];
             clip.hasAudio = entry["hasAudio"];
-            
-            // Load and configure split screen video clips
-            clip.video.load("videos/" + clip.file);
-            clip.video.setLoopState(OF_LOOP_NORMAL);
-            clip.video.stop();  // Stop them initially
-            clip.video.setVolume(0.0f); // Silent by default
+            clip.videoPath = "videos/" + clip.file;
 
             splitScreenClips.push_back(clip);
-            ofLog() << "Loaded " << splitScreenClips.size() << " split screen clips.";
-
         }
+        ofLog() << "Found " << splitScreenClips.size() << " split screen clips.";
+    
+        // Shuffle up front so the first split clip is known and can be preloaded
+        if (!splitScreenClips.empty()) {
+            randomizeSplitScreenOrder();
+        }
+        updateClipWindow();
     
     // Setup MIDI input
     midiIn.listInPorts();  // List available MIDI ports
@@ -69,9 +79,13 @@ void ChronologyManager::setup() {
 
 
 void ChronologyManager::update() {
-    if (currentTopic) {
-        // If manual looping is enabled, manage loop playback timing
-        if (isLooping) {
+    PROFILE_SCOPE("chronology");
+    receiveLoadedClips();
+    processMidiEvents();
+    
+    if (currentTopic && getCurrentVideo()) {
+        // If manual looping is enabled (and not from the cache), manage loop playback timing
+        if (isLooping && !playingAnchor && !loopCache.isPlaying()) {
             // Get current playback time in seconds
             float currentTime = currentTopic->footage[currentFootageIndex].video.getPosition() *
                                 currentTopic->footage[currentFootageIndex].video.getDuration();
@@ -91,14 +105,193 @@ void ChronologyManager::update() {
                 // Stop anchor playback
                 currentTopic->anchor.video.stop();
 
-                // Anchor completed; switch to footage
+                // Anchor completed; switch to footage (already shuffled when the topic was picked)
                 playingAnchor = false;
                 currentFootageIndex = 0;
-                randomizeFootageOrder();
+                playCurrentFootage();
             }
+        } else if (loopCache.isPlaying()) {
+            // The decoder waits paused, the loop comes out of RAM on its own clock
+            loopCache.update(ofGetLastFrameTime());
         } else {
             // Update the current looping footage clip
-            currentTopic->footage[currentFootageIndex].video.update();
+            ofVideoPlayer& video = currentTopic->footage[currentFootageIndex].video;
+            video.update();
+            if (loopCacheBudget > 0 && video.isFrameNew()) {
+                recordLoopFrame(video);
+            }
+        }
+        
+        if (getCurrentVideo() && getCurrentVideo()->isFrameNew()) {
+            if (!firstFrameLogged) {
+                firstFrameLogged = true;
+                ofLog() << "Time to first frame: " << ofGetElapsedTimeMillis() - setupStartTime << "ms";
+            }
+            // The first new frame after a switch gets drawn this frame
+            if (switchPending) {
+                recordSwitchLatency();
+            }
+        }
+    }
+    
+    warmNextTopic();
+    updateClipWindow();
+}
+
+// Keeps the decoded frame in case a loop is started in the next few seconds
+void ChronologyManager::recordLoopFrame(ofVideoPlayer& video) {
+    PROFILE_SCOPE("loop cache record");
+    float duration = video.getDuration();
+    if (duration <= 0) return;
+    int totalFrames = video.getTotalNumFrames();
+    float fps = totalFrames > 0 ? totalFrames / duration : 30.0f;
+    loopCache.record(video.getPixels(), video.getPosition() * duration, fps);
+}
+
+void ChronologyManager::setLoopCacheBudget(size_t megabytes) {
+    if (isLooping) stopLooping();
+    loopCacheBudget = megabytes;
+    loopCache.setMemoryBudget(megabytes * 1024 * 1024);
+    ofLog() << "Loop cache budget: " << megabytes << " MB" << (megabytes == 0 ? " (seeking loops)" : "");
+}
+
+void ChronologyManager::exit() {
+    // No more callbacks into a queue that's about to go away
+    midiIn.removeListener(this);
+    midiIn.closePort();
+    clipLoader.stop();
+}
+
+void ChronologyManager::setPreloadWindow(int clips) {
+    preloadWindow = std::max(0, clips);
+}
+
+int ChronologyManager::getPreloadWindow() const {
+    return preloadWindow;
+}
+
+// Works out which players should be open right now: whatever is on screen plus the next
+// preloadWindow clips in play order, then opens/closes decoders to match
+void ChronologyManager::updateClipWindow() {
+    clipWindow.clear();
+    
+    if (currentTopic) {
+        if (playingAnchor) {
+            clipWindow.push_back(&currentTopic->anchor.video);
+        }
+        if (nextTopic) {
+            clipWindow.push_back(&nextTopic->anchor.video);
+        }
+        
+        int footageCount = currentTopic->footage.size();
+        if (footageCount > 0) {
+            // While the anchor plays, footage 0 is the next thing on screen
+            int first = playingAnchor ? 0 : currentFootageIndex;
+            int count = std::min(footageCount, playingAnchor ? preloadWindow : preloadWindow + 1);
+            for (int i = 0; i < count; i++) {
+                clipWindow.push_back(&currentTopic->footage[(first + i) % footageCount].video);
+            }
+        }
+    }
+    
+    if (!splitScreenClips.empty()) {
+        // Keep the clip split screen will open with ready; once it's showing, the next ones too
+        int count = splitScreenMode ? preloadWindow + 1 : 1;
+        for (int i = currentSplitIndex; i < (int)splitScreenClips.size() && i < currentSplitIndex + count; i++) {
+            clipWindow.push_back(&splitScreenClips[i].video);
+        }
+    }
+    
+    for (auto& topic : topics) {
+        syncClip(topic.anchor);
+        for (auto& clip : topic.footage) {
+            syncClip(clip);
+        }
+    }
+    for (auto& clip : splitScreenClips) {
+        syncClip(clip);
+    }
+}
+
+bool ChronologyManager::isInClipWindow(const ofVideoPlayer* video) const {
+    return std::find(clipWindow.begin(), clipWindow.end(), video) != clipWindow.end();
+}
+
+template<typename C>
+void ChronologyManager::syncClip(C& clip) {
+    bool wanted = isInClipWindow(&clip.video);
+    if (wanted && !clip.isLoaded && !clip.isLoading && !clip.loadFailed) {
+        clip.isLoading = true;
+        clipLoader.requestLoad(clip.videoPath);
+    } else if (!wanted && clip.isLoaded) {
+        // Fell out of the window, free the decoder
+        clip.video.close();
+        clip.isLoaded = false;
+    }
+}
+
+template<typename C>
+bool ChronologyManager::adoptClip(C& clip, ClipLoader::LoadedClip& loaded, ofLoopType loopState) {
+    if (!clip.isLoading || clip.videoPath != loaded.path) return false;
+    clip.isLoading = false;
+    
+    if (!loaded.success) {
+        clip.loadFailed = true;
+        ofLogError("ChronologyManager") << "Couldn't load " << loaded.path;
+        return true;
+    }
+    if (!isInClipWindow(&clip.video)) {
+        // Moved on while it was loading
+        loaded.video.close();
+        return true;
+    }
+    
+    clip.video = loaded.video;
+    clip.video.setUseTexture(true); // texture gets allocated on the next update, on this thread
+    clip.video.setLoopState(loopState);
+    clip.isLoaded = true;
+    ofLog() << "Loaded " << loaded.path << " in " << loaded.loadMillis << "ms";
+    return true;
+}
+
+// Hands finished loads over to their clips and starts whatever should already be playing
+void ChronologyManager::receiveLoadedClips() {
+    PROFILE_SCOPE("clip adopt");
+    ClipLoader::LoadedClip loaded;
+    bool adopted = false;
+    
+    while (clipLoader.receive(loaded)) {
+        bool matched = false;
+        for (auto& topic : topics) {
+            matched = adoptClip(topic.anchor, loaded, OF_LOOP_NONE); // Play anchor once
+            for (auto& clip : topic.footage) {
+                if (matched) break;
+                matched = adoptClip(clip, loaded, OF_LOOP_NORMAL); // Loop footage videos indefinitely
+            }
+            if (matched) break;
+        }
+        for (auto& clip : splitScreenClips) {
+            if (matched) break;
+            if (adoptClip(clip, loaded, OF_LOOP_NORMAL)) {
+                matched = true;
+                if (clip.isLoaded) clip.video.setVolume(0.0f); // Silent by default
+            }
+        }
+        adopted |= matched;
+    }
+    
+    if (!adopted) return;
+    
+    if (currentTopic) {
+        Clip& onScreen = playingAnchor ? currentTopic->anchor : currentTopic->footage[currentFootageIndex];
+        if (onScreen.isLoaded && !onScreen.video.isPlaying()) {
+            onScreen.video.play();
+        }
+    }
+    if (splitScreenMode && !splitScreenClips.empty()) {
+        SplitScreenClip& split = splitScreenClips[currentSplitIndex];
+        if (split.isLoaded && !split.video.isPlaying()) {
+            split.video.play();
         }
     }
 }
@@ -108,13 +301,9 @@ void ChronologyManager::draw() {
     if (currentTopic) {
         if (splitScreenMode && !splitScreenClips.empty()) {
             drawSplitScreen();
-        } else {
+        } else if (getCurrentVideo()) {
             // Fullscreen drawing of either anchor or regular footage
-            if (playingAnchor) {
-                currentTopic->anchor.video.draw(0, 0, ofGetWidth(), ofGetHeight());
-            } else {
-                currentTopic->footage[currentFootageIndex].video.draw(0, 0, ofGetWidth(), ofGetHeight());
-            }
+            getCurrentVideo()->draw(0, 0, ofGetWidth(), ofGetHeight());
         }
     }
 }
@@ -124,20 +313,18 @@ void ChronologyManager::drawSplitScreen() {
     float halfWidth = ofGetWidth() / 2.0f;
     float height = ofGetHeight();
 
-    // Draw main footage - left side
-    if (!playingAnchor) {
+    // Draw main footage - left side (anchor if it's active), once its decoder is open
+    ofVideoPlayer* mainVideo = getCurrentVideo();
+    if (mainVideo) {
         // Ensures main video is playing
-        if (!currentTopic->footage[currentFootageIndex].video.isPlaying()) {
-            currentTopic->footage[currentFootageIndex].video.play();
+        if (!playingAnchor && !mainVideo->isPlaying()) {
+            mainVideo->play();
         }
-        currentTopic->footage[currentFootageIndex].video.draw(0, 0, halfWidth, height);
-    } else {
-        // If anchor active, draw instead
-        currentTopic->anchor.video.draw(0, 0, halfWidth, height);
+        mainVideo->draw(0, 0, halfWidth, height);
     }
 
     // Draw right side (split screen content)
-    if (splitScreenMode && !splitScreenClips.empty()) {
+    if (splitScreenMode && !splitScreenClips.empty() && splitScreenClips[currentSplitIndex].isLoaded) {
         // Ensure split screen video is playing
         if (!splitScreenClips[currentSplitIndex].video.isPlaying()) {
             splitScreenClips[currentSplitIndex].video.play();
@@ -200,119 +387,254 @@ void ChronologyManager::keyPressed(int key) {
 }
 
 void ChronologyManager::selectRandomTopic() {
+    if (isLooping) stopLooping();   // resumes the decoder before it gets stopped
+    loopCache.clear();
+    
     // Stop all videos from the current topic (if any) before switching
     if (currentTopic) {
-        currentTopic->anchor.video.stop();
+        if (currentTopic->anchor.isLoaded) {
+            currentTopic->anchor.video.stop();
+        }
         for (auto& clip : currentTopic->footage) {
-            clip.video.stop();
+            if (clip.isLoaded) clip.video.stop();
         }
     }
 
+    if (topics.empty()) return;
+    
+    switchRequestTime = ofGetElapsedTimeMicros();
+    switchPending = true;
+    switchWasWarm = nextTopic && nextAnchorWarm;
+
+    // The next topic was picked (and its anchor warmed) last time round, so this is just a swap
+    currentTopic = nextTopic ? nextTopic : pickRandomTopic();
+    playingAnchor = true;
+    
+    // Shuffle now rather than when the anchor ends, so the first footage clips can preload
+    currentFootageIndex = 0;
+    randomizeFootageOrder();
+
+    // Play the new topic's anchor video (or as soon as the loader has opened it)
+    if (currentTopic->anchor.isLoaded) {
+        if (currentTopic->anchor.video.isPaused()) {
+            currentTopic->anchor.video.setPaused(false); // warmed, already sitting on frame 0
+        } else {
+            currentTopic->anchor.video.play();
+        }
+    }
+    
+    // Pick the one after and start warming it in the background
+    nextTopic = topics.size() > 1 ? pickRandomTopic() : nullptr;
+    nextAnchorWarming = false;
+    nextAnchorWarm = false;
+    
+    updateClipWindow();
+    ofLog() << "Switched to topic: " << currentTopic->name
+            << (nextTopic ? " (next up: " + nextTopic->name + ")" : "");
+}
+
+ChronologyManager::Topic* ChronologyManager::pickRandomTopic() {
     int randomIndex;
     do {
         randomIndex = ofRandom(topics.size());
-    } while (currentTopic && &topics[randomIndex] == currentTopic);
+    } while (topics.size() > 1 && currentTopic && &topics[randomIndex] == currentTopic);
+    return &topics[randomIndex];
+}
 
-    currentTopic = &topics[randomIndex];
-    playingAnchor = true;
+// Gets the next topic's anchor opened, at position 0 and with its first frame decoded and
+// uploaded, then leaves it paused so switching to it only has to unpause
+void ChronologyManager::warmNextTopic() {
+    if (!nextTopic || nextAnchorWarm || !nextTopic->anchor.isLoaded) return;
+    
+    ofVideoPlayer& anchor = nextTopic->anchor.video;
+    if (!nextAnchorWarming) {
+        nextAnchorWarming = true;
+        anchor.play();
+        anchor.setPaused(true);
+        anchor.setPosition(0);
+    }
+    
+    anchor.update();
+    if (anchor.isFrameNew()) {
+        nextAnchorWarm = true;
+        ofLog() << "Warmed anchor for next topic: " << nextTopic->name;
+    }
+}
+
+void ChronologyManager::recordSwitchLatency() {
+    float latency = (ofGetElapsedTimeMicros() - switchRequestTime) / 1000.0f;
+    switchPending = false;
+    
+    lastSwitchLatency = latency;
+    maxSwitchLatency = std::max(maxSwitchLatency, latency);
+    totalSwitchLatency += latency;
+    switchCount++;
+    
+    ofLog() << "Topic switch latency: " << latency << "ms (" << (switchWasWarm ? "warm" : "cold")
+            << ", avg " << getAverageSwitchLatency() << "ms, max " << maxSwitchLatency << "ms)";
+}
+
+float ChronologyManager::getLastSwitchLatency() const {
+    return lastSwitchLatency;
+}
 
-    // Play the new topic's anchor video
-    currentTopic->anchor.video.play();
-    ofLog() << "Switched to topic: " << currentTopic->name;
+float ChronologyManager::getAverageSwitchLatency() const {
+    return switchCount > 0 ? totalSwitchLatency / switchCount : 0;
+}
+
+float ChronologyManager::getMaxSwitchLatency() const {
+    return maxSwitchLatency;
 }
 
 void ChronologyManager::randomizeFootageOrder() {
     std::random_device rd;  // gets random seed from the hardware
     std::mt19937 g(rd());               // Seed the random number generator
     std::shuffle(currentTopic->footage.begin(), currentTopic->footage.end(), g); // Shuffles the footage vector
-    playCurrentFootage(); // Plays the first video in the newly shuffled order
 }
 
 void ChronologyManager::playCurrentFootage() {
+    if (isLooping) stopLooping(); // Reset manual looping
+    loopCache.clear();            // the recorded frames belong to the last clip
+    
     // stops all other video clips except the one currently being played
     for (auto& clip : currentTopic->footage) {
-        if (&clip != &currentTopic->footage[currentFootageIndex]) {
+        if (&clip != &currentTopic->footage[currentFootageIndex] && clip.isLoaded) {
             clip.video.stop(); // stops non-current videos to avoid overlap
         }
     }
     
-    // Start/restart the current video
-    currentTopic->footage[currentFootageIndex].video.setLoopState(OF_LOOP_NORMAL); // loop video
-    currentTopic->footage[currentFootageIndex].video.play();
+    // Start/restart the current video - if it's still loading, receiveLoadedClips starts it
+    if (currentTopic->footage[currentFootageIndex].isLoaded) {
+        currentTopic->footage[currentFootageIndex].video.setLoopState(OF_LOOP_NORMAL); // loop video
+        currentTopic->footage[currentFootageIndex].video.play();
+    }
+    updateClipWindow();
     
-    isLooping = false; // Reset manual looping
     ofLog() << "Playing footage (looped): " << currentTopic->footage[currentFootageIndex].videoPath; // Log current video
 }
 
 // Starts a short manual loop near the current playback position (for the right jogwheel)
 void ChronologyManager::startLooping() {
+    if (!currentTopic->footage[currentFootageIndex].isLoaded) return;
     float currentTime = currentTopic->footage[currentFootageIndex].video.getPosition() *
                         currentTopic->footage[currentFootageIndex].video.getDuration(); // Get current time in seconds
     loopStartTime = std::max(0.0f, currentTime - loopDuration); // Define start of loop, clamped to  0
     loopEndTime = currentTime;  // Define end of loop at current position
     isLooping = true;                  // Enable manual looping
+    
+    // The last few seconds are already in RAM - play those, and leave the decoder paused
+    // where the loop ends rather than seeking it back every time round
+    if (!playingAnchor && loopCacheBudget > 0 && loopCache.startPlayback()) {
+        loopVideo = &currentTopic->footage[currentFootageIndex].video;
+        loopVideo->setPaused(true);
+        ofLog() << "Started looping from the frame cache: " << loopCache.describe();
+        return;
+    }
     ofLog() << "Started looping from " << loopStartTime << "s to " << loopEndTime << "s";
 }
 
 // Stops any active manual looping
 void ChronologyManager::stopLooping() {
     isLooping = false;                 // Disable looping
+    if (loopCache.isPlaying()) {
+        loopCache.stopPlayback();
+        // Picks up right after the loop's last frame
+        if (loopVideo) loopVideo->setPaused(false);
+    }
+    loopVideo = nullptr;
     loopStartTime = 0;                 // Reset loop start
     loopEndTime = 0;                   // Reset loop end
     ofLog() << "Exited the loop.";     // Log loop exit
 }
 
+// Runs on ofxMidi's callback thread - only copies the message out, everything else
+// happens in handleMidiEvent on the main thread
 void ChronologyManager::newMidiMessage(ofxMidiMessage& message) {
-    midiMessage = message; // Store the incoming message for debugging
-    
+    if (!midiEvents.push(MidiEvent::fromMessage(message, ofGetElapsedTimeMicros()))) {
+        droppedMidiEvents++;
+    }
+}
+
+void ChronologyManager::startMidiRecording() {
+    midiReplay.startRecording();
+    droppedAtRecordingStart = droppedMidiEvents.load();
+    ofLog() << "Recording MIDI events";
+}
+
+void ChronologyManager::stopMidiRecording(const std::string& path) {
+    midiReplay.stopRecording(path);
+    uint64_t dropped = droppedMidiEvents.load() - droppedAtRecordingStart;
+    if (dropped > 0) {
+        ofLogWarning("ChronologyManager") << dropped << " MIDI events dropped while recording (queue full)";
+    }
+}
+
+bool ChronologyManager::isRecordingMidi() const {
+    return midiReplay.isRecording();
+}
+
+// Plays a recorded stream back through the same path as the controller
+bool ChronologyManager::replayMidi(const std::string& path) {
+    if (!midiReplay.load(path)) return false;
+    midiReplay.start(ofGetElapsedTimeMicros());
+    return true;
+}
+
+void ChronologyManager::processMidiEvents() {
+    PROFILE_SCOPE("midi");
+    MidiEvent event;
+    while (midiEvents.pop(event)) {
+        midiReplay.record(event);
+        handleMidiEvent(event);
+    }
+    while (midiReplay.next(ofGetElapsedTimeMicros(), event)) {
+        handleMidiEvent(event);
+    }
+}
+
+void ChronologyManager::handleMidiEvent(const MidiEvent& event) {
     if (currentTopic && !playingAnchor) {
         // Handle jogwheel (Controller #25)
-        if (message.status == MIDI_CONTROL_CHANGE && message.control == 25) {
-            static bool jogwheelSpinning = false;
-            static bool jogwheelReversed = false;
-            static unsigned long lastMovementTime = 0;
+        if (event.status == MIDI_CONTROL_CHANGE && event.control == 25) {
             const int movementThresholdMin = 5;
             const int movementThresholdMax = 10;
             const int reverseMovementThresholdMin = 110;
             const int reverseMovementThresholdMax = 124;
+            const uint64_t releaseDelay = 100000; // micros since the last movement before a release counts
             
-            if (message.value >= movementThresholdMin && message.value <= movementThresholdMax) {
-                jogwheelSpinning = true;
-                jogwheelReversed = false;
-                lastMovementTime = ofGetElapsedTimeMillis();
-            } else if (message.value >= reverseMovementThresholdMin && message.value <= reverseMovementThresholdMax) {
-                jogwheelReversed = true;
-                jogwheelSpinning = false;
-                lastMovementTime = ofGetElapsedTimeMillis();
-            } else if (jogwheelSpinning && message.value == 1) {
-                unsigned long now = ofGetElapsedTimeMillis();
-                if (now - lastMovementTime > 100) {
-                    jogwheelSpinning = false;
-                    currentFootageIndex = (currentFootageIndex + 1) % currentTopic->footage.size();
-                    playCurrentFootage();
-                    ofLog() << "Jogwheel released (clockwise): Advancing to next clip";
-                }
-            } else if (jogwheelReversed && message.value == 127) {
-                unsigned long now = ofGetElapsedTimeMillis();
-                if (now - lastMovementTime > 100) {
-                    jogwheelReversed = false;
-                    currentFootageIndex = (currentFootageIndex - 1 + currentTopic->footage.size()) % currentTopic->footage.size();
-                    playCurrentFootage();
-                    ofLog() << "Jogwheel released (anti-clockwise): Going back to previous clip";
-                }
+            bool spinningForward = event.value >= movementThresholdMin && event.value <= movementThresholdMax;
+            bool spinningBack = event.value >= reverseMovementThresholdMin && event.value <= reverseMovementThresholdMax;
+            bool settled = event.timeMicros - jogwheelLastMovement > releaseDelay;
+            
+            if (spinningForward) {
+                jogwheelState = JOG_SPINNING_FORWARD;
+                jogwheelLastMovement = event.timeMicros;
+            } else if (spinningBack) {
+                jogwheelState = JOG_SPINNING_BACK;
+                jogwheelLastMovement = event.timeMicros;
+            } else if (jogwheelState == JOG_SPINNING_FORWARD && event.value == 1 && settled) {
+                jogwheelState = JOG_IDLE;
+                currentFootageIndex = (currentFootageIndex + 1) % currentTopic->footage.size();
+                playCurrentFootage();
+                ofLog() << "Jogwheel released (clockwise): Advancing to next clip";
+            } else if (jogwheelState == JOG_SPINNING_BACK && event.value == 127 && settled) {
+                jogwheelState = JOG_IDLE;
+                currentFootageIndex = (currentFootageIndex - 1 + currentTopic->footage.size()) % currentTopic->footage.size();
+                playCurrentFootage();
+                ofLog() << "Jogwheel released (anti-clockwise): Going back to previous clip";
             }
         }
         
         // Handle jogwheel
-        if (message.status == MIDI_CONTROL_CHANGE && message.control == 24) {
-            if (message.value >= 5 && message.value <= 10) {
+        if (event.status == MIDI_CONTROL_CHANGE && event.control == 24) {
+            if (event.value >= 5 && event.value <= 10) {
                 if (!isLooping) {
                     startLooping();
                 }
                 ofLog() << "Jogwheel turned clockwise: Looping enabled.";
             }
             
-            if (message.value >= 110 && message.value <= 124) {
+            if (event.value >= 110 && event.value <= 124) {
                 if (isLooping) {
                     stopLooping();
                 }
@@ -321,8 +643,8 @@ void ChronologyManager::newMidiMessage(ofxMidiMessage& message) {
         }
         
         // Handles split screen control
-        if (message.status == MIDI_CONTROL_CHANGE && message.control == 10) {
-            bool enableSplitScreen = message.value >= 64;
+        if (event.status == MIDI_CONTROL_CHANGE && event.control == 10) {
+            bool enableSplitScreen = event.value >= 64;
             if (splitScreenMode != enableSplitScreen) {
                 toggleSplitScreen(enableSplitScreen);
                 ofLog() << "MIDI Controller #27: Split screen " << (enableSplitScreen ? "ON" : "OFF");
@@ -331,14 +653,16 @@ void ChronologyManager::newMidiMessage(ofxMidiMessage& message) {
     
         
         // Handles split screen advancement
-        if (message.status == MIDI_NOTE_ON && message.pitch == 66) {
+        if (event.status == MIDI_NOTE_ON && event.pitch == 66) {
             if (!note66Pressed && !note66HasAdvanced) {
                 note66Pressed = true;
                 note66HasAdvanced = true;
                 
                 if (splitScreenMode && !splitScreenClips.empty()) {
                     // Stops current video
-                    splitScreenClips[currentSplitIndex].video.stop();
+                    if (splitScreenClips[currentSplitIndex].isLoaded) {
+                        splitScreenClips[currentSplitIndex].video.stop();
+                    }
                     
                     // Checks if reached end
                     if (currentSplitIndex + 1 >= splitScreenClips.size()) {
@@ -349,15 +673,18 @@ void ChronologyManager::newMidiMessage(ofxMidiMessage& message) {
                         currentSplitIndex++;
                     }
                     
-                    // Start new video from beginning
-                    splitScreenClips[currentSplitIndex].video.play();
+                    // Start new video from beginning (or once it has loaded)
+                    if (splitScreenClips[currentSplitIndex].isLoaded) {
+                        splitScreenClips[currentSplitIndex].video.play();
+                    }
+                    updateClipWindow();
                     
                     ofLog() << "MIDI Note 66: Advanced to split screen clip "
                     << currentSplitIndex << " - " << splitScreenClips[currentSplitIndex].file;
                 }
             }
         }
-        else if (message.status == MIDI_NOTE_OFF && message.pitch == 66) {
+        else if (event.status == MIDI_NOTE_OFF && event.pitch == 66) {
             note66Pressed = false;
             note66HasAdvanced = false;
         }
@@ -367,20 +694,19 @@ void ChronologyManager::newMidiMessage(ofxMidiMessage& message) {
     if (!currentTopic) return;
     
     // Always allow topic switching via MIDI notes 60/51
-    if (message.status == MIDI_NOTE_ON && (message.pitch == 60 || message.pitch == 51)) {
+    if (event.status == MIDI_NOTE_ON && (event.pitch == 60 || event.pitch == 51)) {
         selectRandomTopic();
     }
 }
     
     ofVideoPlayer* ChronologyManager::getCurrentVideo() {
         if (currentTopic) {
-            if (playingAnchor) {
-                return &currentTopic->anchor.video;
-            } else {
-                return &currentTopic->footage[currentFootageIndex].video;
+            Clip& clip = playingAnchor ? currentTopic->anchor : currentTopic->footage[currentFootageIndex];
+            if (clip.isLoaded) {
+                return &clip.video;
             }
         }
-        return nullptr; // Return null if no video is playing
+        return nullptr; // Return null if no video is playing (or it's still loading)
     }
     
 void ChronologyManager::toggleSplitScreen(bool enable) {
@@ -401,15 +727,15 @@ void ChronologyManager::toggleSplitScreen(bool enable) {
             
             // All split screen videos to loop
             for (auto& clip : splitScreenClips) {
-                clip.video.setLoopState(OF_LOOP_NORMAL);
+                if (clip.isLoaded) clip.video.setLoopState(OF_LOOP_NORMAL);
             }
             
-            if (!splitScreenClips[currentSplitIndex].video.isPlaying()) {
+            if (splitScreenClips[currentSplitIndex].isLoaded && !splitScreenClips[currentSplitIndex].video.isPlaying()) {
                 splitScreenClips[currentSplitIndex].video.play();
             }
             ofLog() << "Split screen activated with clip: " << splitScreenClips[currentSplitIndex].file;
             
-            if (!playingAnchor && !currentTopic->footage[currentFootageIndex].video.isPlaying()) {
+            if (!playingAnchor && getCurrentVideo() && !getCurrentVideo()->isPlaying()) {
                 playCurrentFootage();
             }
         } else {
@@ -419,10 +745,12 @@ void ChronologyManager::toggleSplitScreen(bool enable) {
         }
     } else {
         for (auto& clip : splitScreenClips) {
-            clip.video.setPaused(true);
+            if (clip.isLoaded) clip.video.setPaused(true);
+        }
+        // Reshuffle for the next activation - done now so its first clip can preload
+        if (!splitScreenClips.empty()) {
+            randomizeSplitScreenOrder();
         }
-        // Reshuffle when split screen is activated
-        needReshuffleSplitScreen = true;
         ofLog() << "Split screen deactivated (videos paused)";
     }
 }
@@ -3,6 +3,10 @@
 #include "ofxJSON.h"
 #include "ofxMidi.h"
 #include "ofSoundStream.h"
+#include "ClipLoader.hpp"
+#include "LoopFrameCache.hpp"
+#include "MidiReplay.hpp"
+#include "SpscQueue.hpp"
 
 // Forward declare ofApp to break circular dependency
 class ofApp;
@@ -14,6 +18,9 @@ public:
         std::string videoPath;
         std::string description;
         ofVideoPlayer video;
+        bool isLoaded = false;    // decoder open and ready to play
+        bool isLoading = false;   // queued on the ClipLoader
+        bool loadFailed = false;  // don't keep retrying a broken file
     };
 
     // Struct for topics
@@ -27,12 +34,17 @@ public:
         std::string id;
         std::string file;
         bool hasAudio;
+        std::string videoPath;
         ofVideoPlayer video;
+        bool isLoaded = false;
+        bool isLoading = false;
+        bool loadFailed = false;
     };
     
     // Variables
     std::vector<Topic> topics;
     Topic* currentTopic = nullptr;
+    Topic* nextTopic = nullptr;     // picked ahead of time so its anchor can be warmed
     vector<SplitScreenClip> splitScreenClips;
 
     int currentFootageIndex = 0;
@@ -42,10 +54,15 @@ public:
     void setup() override;
     void update() override;
     void draw() override;
+    void exit() override;
     void keyPressed(int key) override;
     
     // MIDI methods
-    void newMidiMessage(ofxMidiMessage& message);
+    void newMidiMessage(ofxMidiMessage& message); // ofxMidi thread, just queues the event
+    void startMidiRecording();
+    void stopMidiRecording(const std::string& path);
+    bool isRecordingMidi() const;
+    bool replayMidi(const std::string& path);   // feeds a recording through handleMidiEvent
     void drawSplitScreen();
 
     ofVideoPlayer* getCurrentVideo();
@@ -57,30 +74,90 @@ public:
     bool splitScreenMode = false;
     int currentSplitIndex = 0;
 
+    // How many clips past the one on screen get their decoders opened ahead of time
+    // (also read from "preload_window" in footage.json)
+    void setPreloadWindow(int clips);
+    int getPreloadWindow() const;
+    
+    // Manual loops play the last loopDuration seconds back from RAM instead of seeking the
+    // decoder, in at most this much memory (also read from "loop_cache_mb" in footage.json,
+    // 0 goes back to seeking)
+    void setLoopCacheBudget(size_t megabytes);
+    // Playing while a cached loop is on screen - the footage decoder is paused meanwhile
+    const LoopFrameCache& getLoopCache() const { return loopCache; }
+    
+    // Topic switch latency, from the switch request to the first new frame of the new topic (ms)
+    float getLastSwitchLatency() const;
+    float getAverageSwitchLatency() const;
+    float getMaxSwitchLatency() const;
+
 
 private:
 
     void selectRandomTopic();
+    Topic* pickRandomTopic();
+    void warmNextTopic();
+    void recordSwitchLatency();
     void randomizeFootageOrder();
     void playCurrentFootage();
     void startLooping();
     void stopLooping();
     void randomizeSplitScreenOrder();
     
+    // Lazy decoder lifecycle
+    void updateClipWindow();
+    void receiveLoadedClips();
+    bool isInClipWindow(const ofVideoPlayer* video) const;
+    template<typename C> void syncClip(C& clip);
+    template<typename C> bool adoptClip(C& clip, ClipLoader::LoadedClip& loaded, ofLoopType loopState);
+    
     bool isLooping = false;           // To track whether the loop is active
     float loopStartTime = 0;
    float loopEndTime = 0; // Time when the loop starts
     float loopDuration = 6.0f;       // 10 seconds for the loop
     bool isVideoLooping = false;
     
+    LoopFrameCache loopCache;         // recent footage frames, frozen and played back while looping
+    size_t loopCacheBudget = 512;     // MB
+    ofVideoPlayer* loopVideo = nullptr; // decoder paused under a cached loop
+    void recordLoopFrame(ofVideoPlayer& video);
+    
     // MIDI objects
     ofxMidiIn midiIn;
-    ofxMidiMessage midiMessage;
+    SpscQueue<MidiEvent> midiEvents{256};  // ofxMidi thread -> update()
+    std::atomic<uint64_t> droppedMidiEvents{0};   // queue full, missing from the recording
+    uint64_t droppedAtRecordingStart = 0;
+    MidiReplay midiReplay;
+    
+    void processMidiEvents();
+    void handleMidiEvent(const MidiEvent& event);
+    
+    // Right jogwheel (CC 25): spin it one way then let go to step through the footage
+    enum JogwheelState { JOG_IDLE, JOG_SPINNING_FORWARD, JOG_SPINNING_BACK };
+    JogwheelState jogwheelState = JOG_IDLE;
+    uint64_t jogwheelLastMovement = 0;  // event time in micros
     
     bool note66Pressed = false;
     bool note66HasAdvanced = false;
     bool needReshuffleSplitScreen = true;
     
+    ClipLoader clipLoader;
+    int preloadWindow = 2;
+    std::vector<const ofVideoPlayer*> clipWindow; // players that should currently have an open decoder
+    uint64_t setupStartTime = 0;
+    bool firstFrameLogged = false;
+    
+    bool nextAnchorWarming = false;   // paused at frame 0, waiting for the frame to decode
+    bool nextAnchorWarm = false;
+    
+    uint64_t switchRequestTime = 0;
+    bool switchPending = false;
+    bool switchWasWarm = false;
+    float lastSwitchLatency = 0;
+    float maxSwitchLatency = 0;
+    float totalSwitchLatency = 0;
+    int switchCount = 0;
+    
 
     
 
@@ -0,0 +1,47 @@
+//
+//  ClipLoader.cpp
+//  visual-soundfx-test2
+//
+
+#include "ClipLoader.hpp"
+
+ClipLoader::~ClipLoader() {
+    stop();
+}
+
+void ClipLoader::setup() {
+    if (!isThreadRunning()) {
+        startThread();
+    }
+}
+
+void ClipLoader::stop() {
+    // Closing the channel wakes the worker up so it can exit
+    requests.close();
+    if (isThreadRunning()) {
+        waitForThread(true);
+    }
+}
+
+void ClipLoader::requestLoad(const std::string &path) {
+    requests.send(path);
+}
+
+bool ClipLoader::receive(LoadedClip &loaded) {
+    return loadedClips.tryReceive(loaded);
+}
+
+void ClipLoader::threadedFunction() {
+    std::string path;
+    while (requests.receive(path)) {
+        LoadedClip loaded;
+        loaded.path = path;
+
+        uint64_t start = ofGetElapsedTimeMillis();
+        loaded.video.setUseTexture(false); // no GL on this thread
+        loaded.success = loaded.video.load(path);
+        loaded.loadMillis = ofGetElapsedTimeMillis() - start;
+
+        loadedClips.send(std::move(loaded));
+    }
+}
@@ -0,0 +1,38 @@
+//
+//  ClipLoader.hpp
+//  visual-soundfx-test2
+//
+//  Opens video clips on a worker thread so ChronologyManager only has to hold decoders for
+//  the clips that are about to play. Players are loaded without a texture - the texture is
+//  created on the main thread (which owns the GL context) on their first update().
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class ClipLoader : public ofThread {
+public:
+    struct LoadedClip {
+        std::string path;
+        ofVideoPlayer video;
+        bool success = false;
+        uint64_t loadMillis = 0;  // time spent opening the file
+    };
+
+    ~ClipLoader();
+
+    void setup();
+    void stop();
+
+    // Queues a clip to be opened (main thread)
+    void requestLoad(const std::string &path);
+    // Hands back the next finished clip, if any (main thread, never blocks)
+    bool receive(LoadedClip &loaded);
+
+private:
+    void threadedFunction() override;
+
+    ofThreadChannel<std::string> requests;
+    ofThreadChannel<LoadedClip> loadedClips;
+};
@@ -0,0 +1,395 @@
+//
+//  EffectBenchmark.cpp
+//  visual-soundfx-test2
+//
+
+#include "EffectBenchmark.hpp"
+#include "AllocationCounter.hpp"
+#include "MotionBlur.hpp"
+#include "MotionBlurKernel.hpp"
+#include "StepPrint.hpp"
+#include "Glitch.hpp"
+#include "FisheyeLens.hpp"
+#include "Static.hpp"
+#include "TilePool.hpp"
+
+namespace {
+    const int patternFrames = 4;    // cycled through, enough for every frame to differ from the last
+
+    bool sizeFromName(const std::string &name, int &width, int &height) {
+        if (name == "720p") { width = 1280; height = 720; return true; }
+        if (name == "1080p") { width = 1920; height = 1080; return true; }
+        if (name == "2160p" || name == "4k") { width = 3840; height = 2160; return true; }
+        return false;
+    }
+}
+
+bool EffectBenchmark::parseArguments(int argc, char *argv[], Settings &settings) {
+    bool benchmark = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc && argv[i + 1][0] != '-';
+
+        if (arg == "--benchmark") {
+            benchmark = true;
+            if (hasValue) settings.outputPath = argv[++i];
+        } else if (arg == "--iterations" && hasValue) {
+            settings.iterations = std::max(ofToInt(argv[++i]), 1);
+        } else if (arg == "--sizes" && hasValue) {
+            settings.sizes = ofSplitString(ofToLower(argv[++i]), ",", true, true);
+        } else if (arg == "--threads" && hasValue) {
+            settings.threads.clear();
+            for (const auto &count : ofSplitString(argv[++i], ",", true, true)) {
+                settings.threads.push_back(std::max(ofToInt(count), 1));
+            }
+        }
+    }
+    return benchmark;
+}
+
+void EffectBenchmark::update() {
+    if (done) return;
+    done = true;
+
+    ofSetFrameRate(0);
+    ofSetVerticalSync(false);
+    int defaultThreads = TilePool::get().getThreadCount();
+    ofLog() << "Benchmark: " << settings.iterations << " iterations per case, motion blur kernel "
+            << MotionBlurKernel::getInstructionSet() << ", " << defaultThreads << " threads";
+
+    checkStepsReference();
+
+    for (const auto &size : settings.sizes) {
+        int width, height;
+        if (!sizeFromName(size, width, height)) {
+            ofLogWarning("EffectBenchmark") << "Unknown size " << size << " (720p, 1080p or 2160p)";
+            continue;
+        }
+        runSize(size, width, height);
+        runScaling(size, width, height);
+        TilePool::get().setThreadCount(defaultThreads);
+    }
+
+    ofExit(save() ? 0 : 1);
+}
+
+void EffectBenchmark::draw() {
+    ofBackground(0);
+}
+
+void EffectBenchmark::runSize(const std::string &size, int width, int height) {
+    // The patterns are made before anything is timed
+    frames.resize(patternFrames);
+    for (int i = 0; i < patternFrames; i++) {
+        makePattern(frames[i].pixels, width, height, i);
+        frames[i].texture.loadData(frames[i].pixels);
+    }
+    auto pixelsAt = [&](int frame) -> const ofPixels & { return frames[frame % patternFrames].pixels; };
+    auto textureAt = [&](int frame) -> const ofTexture & { return frames[frame % patternFrames].texture; };
+
+    ofFbo target;
+    target.allocate(width, height, GL_RGBA);
+
+    // Fresh instances per size so no state (or allocation) carries over between cases
+    {
+        MotionBlur motionBlur;
+        motionBlur.setup(1.0f, 0.6f);
+        measure("motionblur.update", size, width, height, [&](int frame) {
+            motionBlur.update(pixelsAt(frame));
+        });
+    }
+    {
+        MotionBlur motionBlur;
+        motionBlur.setup(1.0f, 0.6f);
+        motionBlur.setMode(MotionBlur::MODE_GPU);
+        if (motionBlur.getMode() == MotionBlur::MODE_GPU) {
+            measure("motionblur.update.gpu", size, width, height, [&](int frame) {
+                motionBlur.update(textureAt(frame));
+            });
+            
+            // Shader against the CPU kernel on every pattern step, at a stretch big enough to move blocks
+            for (float stretch : {0.6f, 2.0f}) {
+                motionBlur.setStretchAmount(stretch);
+                for (int i = 0; i < patternFrames; i++) {
+                    MotionBlur::ParityResult parity = motionBlur.checkParity(pixelsAt(i + 1), pixelsAt(i));
+                    ParityCheck check;
+                    check.size = size;
+                    check.stretchAmount = stretch;
+                    check.frame = i;
+                    check.maxDifference = parity.maxDifference;
+                    check.mismatchedFraction = parity.mismatchedFraction;
+                    check.passed = parity.passed;
+                    parityChecks.push_back(check);
+                    if (!parity.passed) {
+                        ofLogError("EffectBenchmark") << "Motion blur shader differs from the CPU kernel @ " << size << ", stretch "
+                                                      << stretch << ", frame " << i << ": " << ofToString(parity.mismatchedFraction * 100.0f, 3)
+                                                      << "% of pixels (max difference " << parity.maxDifference << ")";
+                    }
+                }
+            }
+        }
+    }
+    {
+        StepPrinting stepPrinting;
+        stepPrinting.setup(1); // capture every frame, the worst case
+        measure("steps.update", size, width, height, [&](int frame) {
+            stepPrinting.update(textureAt(frame));
+        });
+        measure("steps.apply", size, width, height, [&](int frame) {
+            stepPrinting.apply(target);
+        });
+    }
+    {
+        GlitchEffect glitch;
+        glitch.setup();
+        glitch.setSeed(1);
+        measure("glitch.update.continuous", size, width, height, [&](int frame) {
+            glitch.setGlitchInterval(std::numeric_limits<int>::max()); // the strong pass never comes due
+            glitch.update(pixelsAt(frame));
+        });
+        measure("glitch.update.strong", size, width, height, [&](int frame) {
+            glitch.triggerGlitch();
+            glitch.update(pixelsAt(frame));
+        });
+    }
+    {
+        FisheyeLens fisheye;
+        fisheye.setup(1.5f);
+        fisheye.setBassLevel(0.8f); // pulses and movement on, so the mesh changes every frame
+        measure("fisheye.update", size, width, height, [&](int frame) {
+            fisheye.update(textureAt(frame));
+        });
+    }
+    {
+        StaticEffect staticEffect;
+        staticEffect.setup();
+        staticEffect.toggleStatic(true);
+        measure("static.update+apply", size, width, height, [&](int frame) {
+            staticEffect.update();
+            target.begin();
+            ofClear(0, 0, 0, 255);
+            staticEffect.apply(textureAt(frame), 0, 0, width, height);
+            target.end();
+        });
+    }
+
+    frames.clear();
+}
+
+void EffectBenchmark::runScaling(const std::string &size, int width, int height) {
+    std::vector<ofPixels> patterns(patternFrames);
+    for (int i = 0; i < patternFrames; i++) {
+        makePattern(patterns[i], width, height, i);
+    }
+    ofPixels output;
+    output.allocate(width, height, OF_PIXELS_RGBA);
+    ofPixels glitched;
+    ofPixels reference;
+
+    for (int threads : settings.threads) {
+        TilePool::get().setThreadCount(threads);
+        std::string suffix = "@" + ofToString(threads) + "t";
+
+        // Just the CPU kernels, no uploads, so the times are the part the threads share
+        measure("motionblur.kernel" + suffix, size, width, height, [&](int frame) {
+            MotionBlurKernel::process(patterns[(frame + 1) % patternFrames].getData(), patterns[frame % patternFrames].getData(),
+                                      output.getData(), width, height, 4, 0.6f);
+        });
+
+        GlitchEffect glitch;
+        glitch.setup();
+        glitch.setSeed(1);
+        measure("glitch.pass" + suffix, size, width, height, [&](int frame) {
+            glitched = patterns[frame % patternFrames];
+            glitch.applyGlitchEffect(glitched, 1.0f);
+        });
+
+        // Same seed, same passes - has to come out identical whatever the thread count
+        glitch.setSeed(1);
+        glitched = patterns[0];
+        for (int pass = 0; pass < 3; pass++) {
+            glitch.applyGlitchEffect(glitched, 1.0f);
+        }
+        if (!reference.isAllocated()) {
+            reference = glitched;
+        } else if (memcmp(reference.getData(), glitched.getData(), reference.size()) != 0) {
+            ofLogError("EffectBenchmark") << "Glitch output @ " << size << " with " << threads
+                                          << " threads differs from " << settings.threads.front() << " threads";
+            glitchDeterministic = false;
+        }
+    }
+}
+
+void EffectBenchmark::checkStepsReference() {
+    // Pure CPU and independent of resolution, so one small size is enough. Enough captures to
+    // fill the ring, evict and go through the periodic rebuild a couple of times
+    const int width = 320;
+    const int height = 180;
+    ofPixels pattern;
+    for (int maxStoredFrames : {3, 10}) {
+        for (float fadeStrength : {1.5f, 4.0f}) {
+            StepPrintReference reference;
+            reference.setup(maxStoredFrames, fadeStrength);
+            StepsCheck check;
+            check.maxStoredFrames = maxStoredFrames;
+            check.fadeStrength = fadeStrength;
+            check.captures = maxStoredFrames * 3 + 1;
+            for (int i = 0; i < check.captures; i++) {
+                makePattern(pattern, width, height, i);
+                reference.capture(pattern);
+                check.maxDifference = std::max(check.maxDifference, reference.getMaxDifference());
+            }
+            check.passed = check.maxDifference <= stepsTolerance;
+            if (!check.passed) {
+                ofLogError("EffectBenchmark") << "Accumulated step printing drifts from the exact falloff with " << maxStoredFrames
+                                              << " frames, fade " << fadeStrength << ": max difference " << check.maxDifference;
+            }
+            stepsChecks.push_back(check);
+        }
+    }
+}
+
+void EffectBenchmark::measure(const std::string &effect, const std::string &size, int width, int height,
+                              const std::function<void(int)> &frame) {
+    int frameNumber = 0;
+    for (int i = 0; i < settings.warmup; i++) {
+        frame(frameNumber++);
+    }
+    glFinish();
+
+    std::vector<double> times(settings.iterations);
+    AllocationCounter::Snapshot allocationsBefore = AllocationCounter::snapshot();
+    for (int i = 0; i < settings.iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        frame(frameNumber++);
+        glFinish();
+        times[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    AllocationCounter::Snapshot allocationsAfter = AllocationCounter::snapshot();
+
+    Result result;
+    result.effect = effect;
+    result.size = size;
+    result.width = width;
+    result.height = height;
+    result.iterations = settings.iterations;
+    result.threads = TilePool::get().getThreadCount();
+    result.allocationsPerFrame = (double)(allocationsAfter.count - allocationsBefore.count) / settings.iterations;
+    result.bytesPerFrame = (double)(allocationsAfter.bytes - allocationsBefore.bytes) / settings.iterations;
+
+    for (double time : times) result.meanNanos += time;
+    result.meanNanos /= times.size();
+    std::sort(times.begin(), times.end());
+    result.medianNanos = times[times.size() / 2];
+    result.p95Nanos = times[std::min((size_t)(times.size() * 0.95), times.size() - 1)];
+    result.minNanos = times.front();
+
+    ofLog() << effect << " @ " << size << ": " << ofToString(result.medianNanos / 1000000.0, 3) << " ms median, "
+            << ofToString(result.p95Nanos / 1000000.0, 3) << " ms p95, "
+            << (AllocationCounter::isCounting() ? ofToString(result.allocationsPerFrame, 1) : "n/a") << " allocs/frame";
+    results.push_back(result);
+}
+
+void EffectBenchmark::makePattern(ofPixels &pixels, int width, int height, int frame) {
+    pixels.allocate(width, height, OF_PIXELS_RGBA);
+    unsigned char *data = pixels.getData();
+
+    // Scrolling diagonal gradient, a bright bar sweeping across and a bouncing block -
+    // enough motion for the frame differences without being noise
+    int shift = frame * width / 64;
+    int barX = (frame * width / 16) % width;
+    int barWidth = std::max(width / 40, 1);
+    int blockSize = height / 6;
+    int blockX = (frame * width / 24) % (width - blockSize);
+    int blockY = (height - blockSize) / 2 + (int)(sin(frame * 0.8f) * height / 4);
+
+    for (int y = 0; y < height; y++) {
+        unsigned char *row = data + (size_t)y * width * 4;
+        for (int x = 0; x < width; x++) {
+            unsigned char *pixel = row + x * 4;
+            pixel[0] = ((x + shift) % width) * 255 / width;
+            pixel[1] = (y + shift) * 255 / (height + width);
+            pixel[2] = ((x + y + shift) / 16) % 2 ? 160 : 60;
+            pixel[3] = 255;
+
+            bool inBar = x >= barX && x < barX + barWidth;
+            bool inBlock = x >= blockX && x < blockX + blockSize && y >= blockY && y < blockY + blockSize;
+            if (inBar || inBlock) {
+                pixel[0] = 255;
+                pixel[1] = inBlock ? 40 : 255;
+                pixel[2] = inBlock ? 40 : 255;
+            }
+        }
+    }
+}
+
+bool EffectBenchmark::save() const {
+    ofJson json;
+    json["timestamp"] = ofGetTimestampString("%Y-%m-%dT%H:%M:%S");
+    json["iterations"] = settings.iterations;
+    json["warmup"] = settings.warmup;
+    json["window"] = {ofGetWidth(), ofGetHeight()};
+    json["gl_version"] = ofToString(ofGetGLMajorVersion()) + "." + ofToString(ofGetGLMinorVersion());
+    json["motionblur_kernel"] = MotionBlurKernel::getInstructionSet();
+
+    ofJson cases = ofJson::array();
+    for (const auto &result : results) {
+        ofJson entry;
+        entry["effect"] = result.effect;
+        entry["size"] = result.size;
+        entry["width"] = result.width;
+        entry["height"] = result.height;
+        entry["iterations"] = result.iterations;
+        entry["threads"] = result.threads;
+        entry["mean_ns"] = result.meanNanos;
+        entry["median_ns"] = result.medianNanos;
+        entry["p95_ns"] = result.p95Nanos;
+        entry["min_ns"] = result.minNanos;
+        // null when the build doesn't count allocations, see AllocationCounter.hpp
+        entry["allocations_per_frame"] = AllocationCounter::isCounting() ? ofJson(result.allocationsPerFrame) : ofJson();
+        entry["bytes_per_frame"] = AllocationCounter::isCounting() ? ofJson(result.bytesPerFrame) : ofJson();
+        cases.push_back(entry);
+    }
+    json["results"] = cases;
+
+    bool parityPassed = true;
+    ofJson parity = ofJson::array();
+    for (const auto &check : parityChecks) {
+        ofJson entry;
+        entry["effect"] = "motionblur";
+        entry["size"] = check.size;
+        entry["stretch_amount"] = check.stretchAmount;
+        entry["frame"] = check.frame;
+        entry["max_difference"] = check.maxDifference;
+        entry["mismatched_fraction"] = check.mismatchedFraction;
+        entry["passed"] = check.passed;
+        parity.push_back(entry);
+        parityPassed = parityPassed && check.passed;
+    }
+    json["parity"] = parity;
+
+    bool stepsPassed = true;
+    ofJson steps = ofJson::array();
+    for (const auto &check : stepsChecks) {
+        ofJson entry;
+        entry["max_stored_frames"] = check.maxStoredFrames;
+        entry["fade_strength"] = check.fadeStrength;
+        entry["captures"] = check.captures;
+        entry["max_difference"] = check.maxDifference;
+        entry["tolerance"] = stepsTolerance;
+        entry["passed"] = check.passed;
+        steps.push_back(entry);
+        stepsPassed = stepsPassed && check.passed;
+    }
+    json["steps_reference"] = steps;
+    json["glitch_deterministic"] = glitchDeterministic;
+
+    if (!ofSavePrettyJson(settings.outputPath, json)) {
+        ofLogError("EffectBenchmark") << "Can't write " << settings.outputPath;
+        return false;
+    }
+    ofLog() << "Benchmark results (" << results.size() << " cases, " << parityChecks.size() << " parity checks, "
+            << stepsChecks.size() << " step printing checks" << (parityPassed && stepsPassed ? "" : ", some FAILED")
+            << ") saved to " << settings.outputPath;
+    return !results.empty() && parityPassed && stepsPassed && glitchDeterministic;
+}
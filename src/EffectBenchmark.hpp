@@ -0,0 +1,108 @@
+//
+//  EffectBenchmark.hpp
+//  visual-soundfx-test2
+//
+//  Command-line benchmark of each effect at 720p, 1080p and 4K on synthetic moving test
+//  patterns. Reports ns/frame and allocations/frame per case and writes them to JSON so runs
+//  from different releases can be compared. Allocations are only counted in debug builds or
+//  with ALLOCATION_COUNTING=1 (see AllocationCounter.hpp), otherwise they're null in the JSON.
+//
+//    visual-soundfx-test2 --benchmark [results.json] [--iterations n] [--sizes 720p,1080p,2160p]
+//                         [--threads 1,2,4,8]
+//
+//  Every case gets fresh effect instances, a few warm-up frames, then n timed frames. GL work
+//  is finished (glFinish) inside each frame so the times include the GPU side. The patterns
+//  and glitch seed are fixed, so only the machine changes between runs.
+//
+//  The motion blur shader is also checked against the CPU kernel on the same frames; a failed
+//  parity check fails the run. LIBGL_ALWAYS_SOFTWARE=1 (Mesa) runs it on a software context.
+//
+//  The step printing accumulated mode is checked against its exact falloff on the CPU
+//  reference (StepPrintReference) too, and fails the run above stepsTolerance.
+//
+//  The CPU kernels are also timed on their own at each TilePool thread count for scaling, and
+//  the glitch output at every count has to match the single-threaded one byte for byte.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class EffectBenchmark : public ofBaseApp {
+public:
+    struct Settings {
+        std::string outputPath = "benchmark.json";
+        int iterations = 60;
+        int warmup = 5;
+        std::vector<std::string> sizes = {"720p", "1080p", "2160p"};
+        std::vector<int> threads = {1, 2, 4, 8};   // TilePool sizes for the scaling cases
+    };
+
+    // True if the arguments ask for the benchmark (settings filled in)
+    static bool parseArguments(int argc, char *argv[], Settings &settings);
+
+    EffectBenchmark(const Settings &_settings) : settings(_settings) {}
+
+    void update() override;
+    void draw() override;
+
+    struct Result {
+        std::string effect;
+        std::string size;
+        int width = 0;
+        int height = 0;
+        int iterations = 0;
+        int threads = 0;
+        double meanNanos = 0.0;
+        double medianNanos = 0.0;
+        double p95Nanos = 0.0;
+        double minNanos = 0.0;
+        double allocationsPerFrame = 0.0;
+        double bytesPerFrame = 0.0;
+    };
+
+    // One GPU-vs-CPU comparison, see MotionBlur::checkParity
+    struct ParityCheck {
+        std::string size;
+        float stretchAmount = 0.0f;
+        int frame = 0;
+        int maxDifference = 0;
+        float mismatchedFraction = 0.0f;
+        bool passed = false;
+    };
+
+    // Accumulated step printing against the exact falloff, see StepPrintReference
+    struct StepsCheck {
+        int maxStoredFrames = 0;
+        float fadeStrength = 0.0f;
+        int captures = 0;
+        float maxDifference = 0.0f;     // 0-1 units, worst over every capture
+        bool passed = false;
+    };
+    // Half an 8 bit step - anything above would show in the output
+    static constexpr float stepsTolerance = 0.5f / 255.0f;
+
+private:
+    // One moving frame of the test pattern, as pixels and as a texture
+    struct TestFrame {
+        ofPixels pixels;
+        ofTexture texture;
+    };
+
+    void runSize(const std::string &size, int width, int height);
+    void runScaling(const std::string &size, int width, int height);
+    void checkStepsReference();
+    // Warm-up plus timed iterations of frame(i), i being the frame number
+    void measure(const std::string &effect, const std::string &size, int width, int height,
+                 const std::function<void(int)> &frame);
+    static void makePattern(ofPixels &pixels, int width, int height, int frame);
+    bool save() const;
+
+    Settings settings;
+    std::vector<TestFrame> frames;
+    std::vector<Result> results;
+    std::vector<ParityCheck> parityChecks;
+    std::vector<StepsCheck> stepsChecks;
+    bool glitchDeterministic = true;
+    bool done = false;
+};
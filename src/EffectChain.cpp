@@ -0,0 +1,246 @@
+//
+//  EffectChain.cpp
+//  visual-soundfx-test2
+//
+
+#include "EffectChain.hpp"
+#include "FrameProfiler.hpp"
+
+EffectStage::EffectStage(const std::string &_name) : name(_name) {
+    profileSection = FrameProfiler::get().addSection("stage " + name, true);
+}
+
+void EffectChain::allocate(int width, int height) {
+    if (width == outputWidth && height == outputHeight) return;
+    outputWidth = width;
+    outputHeight = height;
+    sizesDirty = true;
+}
+
+void EffectChain::setSourceSize(int width, int height) {
+    if (width == sourceWidth && height == sourceHeight) return;
+    sourceWidth = width;
+    sourceHeight = height;
+    sizesDirty = true;
+}
+
+void EffectChain::getScaledSize(float scale, int &width, int &height) const {
+    if (scale == EffectStage::matchSource) {
+        // SD footage on a 4K output works at SD, a 4K clip in a small window at the window size
+        scale = (sourceHeight > 0 && outputHeight > 0) ? std::min((float)sourceHeight / outputHeight, 1.0f) : 1.0f;
+    }
+    width = std::max((int)roundf(outputWidth * scale), 1);
+    height = std::max((int)roundf(outputHeight * scale), 1);
+}
+
+void EffectChain::addStage(std::unique_ptr<EffectStage> stage) {
+    int index = stage->replacesInput() ? countReplacingStages() : stages.size();
+    stages.insert(stages.begin() + index, std::move(stage));
+    sizesDirty = true;
+}
+
+void EffectChain::resizeStages() {
+    sizesDirty = false;
+    if (outputWidth <= 0 || outputHeight <= 0) return;
+    
+    for (auto &stage : stages) {
+        int width, height;
+        getScaledSize(stage->renderScale, width, height);
+        if (width == stage->width && height == stage->height) continue;
+        
+        stage->width = width;
+        stage->height = height;
+        stage->resize(width, height);
+        ofLog() << "Effect chain: " << stage->getName() << " at " << width << "x" << height;
+    }
+    renderDirty = true;
+}
+
+void EffectChain::update(const ofTexture &source, const ofPixels *sourcePixels, bool newFrame, bool newPixels) {
+    PROFILE_SCOPE("effects update");
+    countRates();
+    if (newFrame) counting.videoFrames++;
+    if (sizesDirty) resizeStages(); // before the updates, stage buffers follow the size
+    
+    for (auto &stage : stages) {
+        if (!stage->isEnabled()) continue;
+        
+        // Content-driven work (readbacks, pixel loops) has nothing new to do until its input changes -
+        // the video frame, or for the CPU stages the readback of it
+        if (stage->isTimeDriven()) {
+            counting.timeUpdates++;
+        } else if (stage->usesSourcePixels() ? newPixels : newFrame) {
+            counting.contentUpdates++;
+        } else {
+            continue;
+        }
+        stage->update(source, sourcePixels);
+        renderDirty = true;
+    }
+    
+    // The source itself has changed even if no stage is on
+    if (newFrame) renderDirty = true;
+}
+
+const ofTexture &EffectChain::render(const ofTexture &source) {
+    PROFILE_SCOPE("effects render");
+    if (sizesDirty) resizeStages();
+    if (!renderDirty && lastOutput && lastSource == &source) {
+        counting.reusedRenders++;
+        return *lastOutput;
+    }
+    counting.renders++;
+    
+    const ofTexture *input = &source;
+
+    for (auto &stage : stages) {
+        if (!stage->isEnabled() || stage->width <= 0) continue;
+
+        FrameProfiler::Scope scope(stage->getProfileSection());
+        ofFbo &output = stage->target;
+        if (!output.isAllocated() || output.getWidth() != stage->width || output.getHeight() != stage->height) {
+            output.allocate(stage->width, stage->height, GL_RGBA);
+        }
+        output.begin();
+        ofClear(0, 0, 0, 255);
+        ofSetColor(255);
+        stage->render(*input, stage->width, stage->height);
+        output.end();
+        FrameProfiler::get().countFrameCopy();
+
+        // This stage's output is the next one's input
+        input = &output.getTexture();
+    }
+
+    ofSetColor(255);
+    renderDirty = false;
+    lastSource = &source;
+    lastOutput = input;
+    return *input;
+}
+
+bool EffectChain::hasEnabledStages() const {
+    for (const auto &stage : stages) {
+        if (stage->isEnabled()) return true;
+    }
+    return false;
+}
+
+bool EffectChain::needsSourcePixels() const {
+    for (const auto &stage : stages) {
+        if (stage->isEnabled() && stage->usesSourcePixels()) return true;
+    }
+    return false;
+}
+
+bool EffectChain::setEnabled(const std::string &name, bool enabled) {
+    int index = findStage(name);
+    if (index < 0) {
+        ofLogWarning("EffectChain") << "No stage called " << name;
+        return false;
+    }
+    if (enabled && stages[index]->replacesInput()) {
+        // Only the last one would be seen - the other's work would never reach the screen
+        for (auto &stage : stages) {
+            if (stage != stages[index] && stage->isEnabled() && stage->replacesInput()) {
+                stage->setEnabled(false);
+                renderDirty = true;
+                ofLog() << "Effect chain: " << stage->getName() << " off, " << name << " replaces it";
+            }
+        }
+    }
+    if (stages[index]->isEnabled() != enabled) {
+        stages[index]->setEnabled(enabled);
+        renderDirty = true;
+        ofLog() << "Effect chain: " << describe();
+    }
+    return true;
+}
+
+bool EffectChain::setRenderScale(const std::string &name, float scale) {
+    int index = findStage(name);
+    if (index < 0) {
+        ofLogWarning("EffectChain") << "No stage called " << name;
+        return false;
+    }
+    scale = (scale <= 0.0f) ? EffectStage::matchSource : std::min(scale, 1.0f);
+    if (stages[index]->renderScale != scale) {
+        stages[index]->renderScale = scale;
+        sizesDirty = true;
+    }
+    return true;
+}
+
+bool EffectChain::isEnabled(const std::string &name) const {
+    int index = findStage(name);
+    return index >= 0 && stages[index]->isEnabled();
+}
+
+bool EffectChain::moveStage(const std::string &name, int index) {
+    int from = findStage(name);
+    if (from < 0) {
+        ofLogWarning("EffectChain") << "No stage called " << name;
+        return false;
+    }
+
+    // Input-replacing stages stay in front of the rest, anything before them would be drawn over
+    int replacing = countReplacingStages();
+    bool replaces = stages[from]->replacesInput();
+    int to = replaces ? ofClamp(index, 0, replacing - 1) : ofClamp(index, replacing, (int)stages.size() - 1);
+    if (to != ofClamp(index, 0, (int)stages.size() - 1)) {
+        ofLogWarning("EffectChain") << name << " can't go to position " << index << (replaces ? ", it draws over its input" :
+                                       ", the stages before it draw over their input") << " - moved to " << to;
+    }
+    if (to == from) return true;
+
+    std::unique_ptr<EffectStage> stage = std::move(stages[from]);
+    stages.erase(stages.begin() + from);
+    stages.insert(stages.begin() + to, std::move(stage));
+    renderDirty = true;
+    ofLog() << "Effect chain: " << describe();
+    return true;
+}
+
+EffectStage *EffectChain::getStage(const std::string &name) {
+    int index = findStage(name);
+    return index >= 0 ? stages[index].get() : nullptr;
+}
+
+std::string EffectChain::describe() const {
+    std::string description;
+    for (const auto &stage : stages) {
+        if (!description.empty()) description += " > ";
+        description += stage->getName();
+        if (stage->renderScale == EffectStage::matchSource) {
+            description += "@source";
+        } else if (stage->renderScale != 1.0f) {
+            description += "@" + ofToString(stage->renderScale);
+        }
+        if (!stage->isEnabled()) description += "*";
+    }
+    return description;
+}
+
+void EffectChain::countRates() {
+    uint64_t now = ofGetElapsedTimeMillis();
+    if (now - ratesStartMillis < 1000) return;
+    
+    rates = counting;
+    counting = Rates();
+    ratesStartMillis = now;
+}
+
+int EffectChain::countReplacingStages() const {
+    int count = 0;
+    for (const auto &stage : stages) {
+        if (stage->replacesInput()) count++;
+    }
+    return count;
+}
+
+int EffectChain::findStage(const std::string &name) const {
+    for (int i = 0; i < (int)stages.size(); i++) {
+        if (stages[i]->getName() == name) return i;
+    }
+    return -1;
+}
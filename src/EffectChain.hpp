@@ -0,0 +1,139 @@
+//
+//  EffectChain.hpp
+//  visual-soundfx-test2
+//
+//  Ordered list of effect stages rendered back to back, each into its own FBO, so any number
+//  of effects can be stacked without allocating anything per frame. Each enabled stage is
+//  updated once per new video frame, then rendered with the previous stage's output as its
+//  input.
+//
+//  Every stage works at its own render scale - a fraction of the output size, or matched to
+//  the source video's resolution - so effect cost doesn't have to follow the window. Stages
+//  resample their input as they draw it, and only the final draw of the chain's output
+//  scales up to the window.
+//
+//  Stages built from the source frame instead of their input (replacesInput) draw over
+//  everything before them, so they're kept at the front of the chain and only one of them is
+//  enabled at a time - anything else would be work that never reaches the screen.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class EffectStage {
+public:
+    EffectStage(const std::string &_name);
+    virtual ~EffectStage() {}
+
+    // Once per new video frame, or every app frame for time-driven stages. sourcePixels is the
+    // shared CPU readback of the source frame (nullptr until it's ready), only needed by stages
+    // that return true from usesSourcePixels()
+    virtual void update(const ofTexture &source, const ofPixels *sourcePixels) = 0;
+    // Draws this stage's result for the given input into the currently bound target
+    // (width x height, this stage's size - the input can be any size)
+    virtual void render(const ofTexture &input, float width, float height) = 0;
+    // The stage's size changed, for buffers of its own that should follow it
+    virtual void resize(int width, int height) {}
+
+    // CPU stages work on the source frame rather than their input, so they belong at the front
+    virtual bool usesSourcePixels() const { return false; }
+    // Output made from the source frame alone, the input isn't drawn at all
+    virtual bool replacesInput() const { return false; }
+    // Content-driven stages only change when the video does. Time-driven ones (pulsing, movement)
+    // animate between video frames too, so they get updated - and the chain re-rendered - every app frame
+    virtual bool isTimeDriven() const { return false; }
+
+    const std::string &getName() const { return name; }
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool _enabled) { enabled = _enabled; }
+    int getProfileSection() const { return profileSection; }
+
+    // Fraction of the chain's output size this stage renders at, or matchSource
+    static constexpr float matchSource = 0.0f;
+    float getRenderScale() const { return renderScale; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    friend class EffectChain;   // sizes and renders into target
+
+    std::string name;
+    bool enabled = false;
+    int profileSection;     // FrameProfiler section timing this stage's render (CPU + GPU)
+    float renderScale = 1.0f;
+    int width = 0;
+    int height = 0;
+    ofFbo target;           // allocated the first time the stage renders at this size
+};
+
+class EffectChain {
+public:
+    // Output size - stages at scale 1 render at this size. Call again when the window resizes.
+    void allocate(int width, int height);
+    // The source video's own size (0 until known), for the stages at matchSource
+    void setSourceSize(int width, int height);
+    // Output size at a render scale, matchSource being the output scaled down (never up) to the
+    // source's height - so the aspect stays the same at every scale
+    void getScaledSize(float scale, int &width, int &height) const;
+
+    // The chain owns its stages, they run in the order added until reordered (input-replacing
+    // stages go in front of the others whatever the order)
+    void addStage(std::unique_ptr<EffectStage> stage);
+
+    // Call every app frame - newFrame says whether the source has changed since the last call,
+    // newPixels whether sourcePixels has (the readback lands a frame after its video frame)
+    void update(const ofTexture &source, const ofPixels *sourcePixels, bool newFrame, bool newPixels);
+    void update(const ofTexture &source, const ofPixels *sourcePixels, bool newFrame) { update(source, sourcePixels, newFrame, newFrame); }
+    // Runs every enabled stage and returns the final texture (the source itself if none are on).
+    // When nothing has changed since the last render the previous output is returned as is
+    const ofTexture &render(const ofTexture &source);
+
+    bool hasEnabledStages() const;
+    bool needsSourcePixels() const;   // any enabled stage wants the CPU readback
+
+    // Enabling an input-replacing stage disables the one that was on
+    bool setEnabled(const std::string &name, bool enabled);
+    bool setRenderScale(const std::string &name, float scale);  // clamped to (0, 1], 0 = matchSource
+    bool isEnabled(const std::string &name) const;
+    // Moves a stage to position index (clamped), the others keep their relative order.
+    // Input-replacing stages can't go behind the others, nor the others in front of them
+    bool moveStage(const std::string &name, int index);
+    EffectStage *getStage(const std::string &name);
+
+    // "motionblur@0.5 > glitch*" style summary, * marks disabled stages, @ a render scale other than 1
+    std::string describe() const;
+    
+    // Per-second counts over the last full second
+    struct Rates {
+        int videoFrames = 0;        // new source frames
+        int contentUpdates = 0;     // content-driven stage updates
+        int timeUpdates = 0;        // time-driven stage updates
+        int renders = 0;            // chain renders
+        int reusedRenders = 0;      // renders skipped because nothing had changed
+    };
+    const Rates &getRates() const { return rates; }
+
+private:
+    int findStage(const std::string &name) const;
+    int countReplacingStages() const;
+    void countRates();
+    // Works out every stage's size again after the output, source or a scale changed
+    void resizeStages();
+
+    std::vector<std::unique_ptr<EffectStage>> stages;
+    int outputWidth = 0;
+    int outputHeight = 0;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    bool sizesDirty = true;
+    
+    // Last render, reused until a stage updates or the chain changes
+    bool renderDirty = true;
+    const ofTexture *lastSource = nullptr;
+    const ofTexture *lastOutput = nullptr;
+    
+    Rates counting;
+    Rates rates;
+    uint64_t ratesStartMillis = 0;
+};
@@ -0,0 +1,56 @@
+//
+//  EffectStages.cpp
+//  visual-soundfx-test2
+//
+
+#include "EffectStages.hpp"
+
+void MotionBlurStage::update(const ofTexture &source, const ofPixels *sourcePixels) {
+    if (!motionBlur.usesPixels()) {
+        motionBlur.update(source);
+        return;
+    }
+    // The readback runs a frame behind, nothing to do until its first frame lands
+    if (sourcePixels) motionBlur.update(*sourcePixels);
+}
+
+void MotionBlurStage::render(const ofTexture &input, float width, float height) {
+    motionBlur.draw(0, 0, width, height);
+}
+
+void MotionBlurStage::resize(int width, int height) {
+    // The blur accumulates at the stage's size, whatever size the source frames come in at
+    motionBlur.allocate(width, height);
+}
+
+void GlitchStage::update(const ofTexture &source, const ofPixels *sourcePixels) {
+    if (sourcePixels) glitch.update(*sourcePixels);
+}
+
+void GlitchStage::render(const ofTexture &input, float width, float height) {
+    glitch.draw(0, 0, width, height);
+}
+
+void StepPrintingStage::update(const ofTexture &source, const ofPixels *sourcePixels) {
+    stepPrinting.update(source);
+}
+
+void StepPrintingStage::render(const ofTexture &input, float width, float height) {
+    input.draw(0, 0, width, height);
+    stepPrinting.draw(width, height);
+}
+
+void FisheyeStage::update(const ofTexture &source, const ofPixels *sourcePixels) {
+    // The input is whatever the stage before rendered, which isn't known until render
+    if (inputWidth == 0) {
+        inputWidth = source.getWidth();
+        inputHeight = source.getHeight();
+    }
+    fisheye.updateWarp(inputWidth, inputHeight);
+}
+
+void FisheyeStage::render(const ofTexture &input, float width, float height) {
+    inputWidth = input.getWidth();
+    inputHeight = input.getHeight();
+    fisheye.drawWarp(input, width, height);
+}
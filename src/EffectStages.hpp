@@ -0,0 +1,64 @@
+//
+//  EffectStages.hpp
+//  visual-soundfx-test2
+//
+//  EffectChain adapters for the existing effects. The effects themselves are still owned by
+//  ofApp (OSC routes and setters talk to them directly), the stages only decide what gets
+//  updated and drawn where.
+//
+
+#pragma once
+
+#include "EffectChain.hpp"
+#include "MotionBlur.hpp"
+#include "StepPrint.hpp"
+#include "FisheyeLens.hpp"
+#include "Glitch.hpp"
+
+// Blurred frame built from the source pixels (or the source texture in GPU mode) - replaces its input
+class MotionBlurStage : public EffectStage {
+public:
+    MotionBlurStage(MotionBlur &_motionBlur) : EffectStage("motionblur"), motionBlur(_motionBlur) {}
+    void update(const ofTexture &source, const ofPixels *sourcePixels) override;
+    void render(const ofTexture &input, float width, float height) override;
+    void resize(int width, int height) override;
+    bool usesSourcePixels() const override { return motionBlur.usesPixels(); }
+    bool replacesInput() const override { return true; }
+private:
+    MotionBlur &motionBlur;
+};
+
+// Glitched copy of the source pixels - replaces its input
+class GlitchStage : public EffectStage {
+public:
+    GlitchStage(GlitchEffect &_glitch) : EffectStage("glitch"), glitch(_glitch) {}
+    void update(const ofTexture &source, const ofPixels *sourcePixels) override;
+    void render(const ofTexture &input, float width, float height) override;
+    bool usesSourcePixels() const override { return true; }
+    bool replacesInput() const override { return true; }
+private:
+    GlitchEffect &glitch;
+};
+
+// Stored source frames added on top of the input as trails
+class StepPrintingStage : public EffectStage {
+public:
+    StepPrintingStage(StepPrinting &_stepPrinting) : EffectStage("steps"), stepPrinting(_stepPrinting) {}
+    void update(const ofTexture &source, const ofPixels *sourcePixels) override;
+    void render(const ofTexture &input, float width, float height) override;
+private:
+    StepPrinting &stepPrinting;
+};
+
+// Warps its input
+class FisheyeStage : public EffectStage {
+public:
+    FisheyeStage(FisheyeLens &_fisheye) : EffectStage("fisheye"), fisheye(_fisheye) {}
+    void update(const ofTexture &source, const ofPixels *sourcePixels) override;
+    void render(const ofTexture &input, float width, float height) override;
+    bool isTimeDriven() const override { return true; } // the pulse and movement run on app time
+private:
+    FisheyeLens &fisheye;
+    int inputWidth = 0;     // size of the last input warped, the mesh is built for it
+    int inputHeight = 0;
+};
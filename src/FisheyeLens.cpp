@@ -1,5 +1,7 @@
 // FisheyeLens.cpp
 #include "FisheyeLens.hpp"
+#include "FrameProfiler.hpp"
+#include "AllocationCounter.hpp"
 
 
 FisheyeLens::FisheyeLens()
@@ -17,7 +19,16 @@ FisheyeLens::FisheyeLens()
   movementSpeed(1.0f), // How quickly the visual offset moves
   movementAmount(0.0f),   // Intensity of movement (based on bass)
   vibrationAmount(0.0f),  // Shaking amount for jitter effect
-  vibrationSpeed(1.0f)    // Speed of vibration oscillation
+  vibrationSpeed(1.0f),    // Speed of vibration oscillation
+  gridStep(10),           // Mesh cell size in pixels
+  meshWidth(0),
+  meshHeight(0),
+  texCoordsValid(false),
+  lastDistortion(0.0f),
+  lastVibration(0.0f),
+  lastPulseStrength(0.0f),
+  lutMaxRadius(0.0f),
+  lutScale(0.0f)
 {
 }
 
@@ -26,8 +37,44 @@ void FisheyeLens::setup(float _distortionStrength) {
     currentDistortion = 0.0f;
     distortionSmoothing = 0.15f;
     
-    // allocates FBO the same size as screen for rendering final distorted image
-    distortedFrame.allocate(ofGetWidth(), ofGetHeight(), GL_RGBA);
+    // distortedFrame is allocated by update() at the size of the frames it gets
+    
+    // r reaches ~2.1 at 16:9 plus the movement offset - 4 covers up to ~3.5:1, libm beyond that
+    buildRadialLut(4.0f, 4096);
+}
+
+void FisheyeLens::buildRadialLut(float maxRadius, int size) {
+    lutMaxRadius = maxRadius;
+    lutScale = (size - 1) / maxRadius;
+    thetaOverRTable.resize(size + 1); // one spare entry so interpolation never reads past the end
+    pulseSineTable.resize(size + 1);
+    
+    for (int i = 0; i <= size; i++) {
+        float r = i / lutScale;
+        thetaOverRTable[i] = (r > 0.0f) ? atan(r) / r : 1.0f;
+        pulseSineTable[i] = sin(r * PI * 2.0f);
+    }
+}
+
+float FisheyeLens::lookupThetaOverR(float r) const {
+    if (r >= lutMaxRadius || thetaOverRTable.empty()) {
+        return (r > 0.0f) ? atan(r) / r : 1.0f;
+    }
+    // Linear interpolation between the two nearest entries
+    float position = r * lutScale;
+    int index = (int)position;
+    float t = position - index;
+    return thetaOverRTable[index] + (thetaOverRTable[index + 1] - thetaOverRTable[index]) * t;
+}
+
+float FisheyeLens::lookupPulseSine(float r) const {
+    if (r >= lutMaxRadius || pulseSineTable.empty()) {
+        return sin(r * PI * 2.0f);
+    }
+    float position = r * lutScale;
+    int index = (int)position;
+    float t = position - index;
+    return pulseSineTable[index] + (pulseSineTable[index + 1] - pulseSineTable[index]) * t;
 }
 
 
@@ -51,7 +98,90 @@ void FisheyeLens::setMaxDistortion(float max) {
     maxDistortion = max;
 }
 
+void FisheyeLens::setGridStep(int step) {
+    step = ofClamp(step, 2, 100);
+    if (step != gridStep) {
+        gridStep = step;
+        meshWidth = 0; // rebuilt on the next update
+        meshHeight = 0;
+    }
+}
+
+int FisheyeLens::getGridStep() const {
+    return gridStep;
+}
+
+FisheyeLens::WarpBenchmark FisheyeLens::benchmarkRadialLut(int width, int height, int step, int iterations) {
+    if (thetaOverRTable.empty()) {
+        buildRadialLut(4.0f, 4096);
+    }
+    
+    // Radii of every grid vertex, same normalisation as updateTexCoords
+    float maxDim = std::max(width, height);
+    float scaleX = (float)width / maxDim;
+    float scaleY = (float)height / maxDim;
+    std::vector<float> radii;
+    for (int y = 0; y <= height; y += step) {
+        for (int x = 0; x <= width; x += step) {
+            float nx = (((float)x / width) * 2.0f - 1.0f) / scaleX;
+            float ny = (((float)y / height) * 2.0f - 1.0f) / scaleY;
+            radii.push_back(sqrt(nx * nx + ny * ny));
+        }
+    }
+    
+    WarpBenchmark result;
+    result.step = step;
+    result.vertices = radii.size();
+    result.maxError = 0.0f;
+    volatile float sink = 0.0f; // keeps the loops from being optimised away
+    
+    uint64_t start = ofGetElapsedTimeMicros();
+    for (int i = 0; i < iterations; i++) {
+        float sum = 0.0f;
+        for (float r : radii) {
+            sum += ((r > 0.0f) ? atan(r) / r : 1.0f) + sin(r * PI * 2.0f);
+        }
+        sink = sink + sum;
+    }
+    uint64_t libmTime = ofGetElapsedTimeMicros() - start;
+    
+    start = ofGetElapsedTimeMicros();
+    for (int i = 0; i < iterations; i++) {
+        float sum = 0.0f;
+        for (float r : radii) {
+            sum += lookupThetaOverR(r) + lookupPulseSine(r);
+        }
+        sink = sink + sum;
+    }
+    uint64_t lutTime = ofGetElapsedTimeMicros() - start;
+    
+    for (float r : radii) {
+        float thetaError = fabs(lookupThetaOverR(r) - ((r > 0.0f) ? atan(r) / r : 1.0f));
+        float sineError = fabs(lookupPulseSine(r) - sin(r * PI * 2.0f));
+        result.maxError = std::max(result.maxError, std::max(thetaError, sineError));
+    }
+    
+    double calls = (double)iterations * std::max<size_t>(radii.size(), 1);
+    result.libmNanos = libmTime * 1000.0 / calls;
+    result.lutNanos = lutTime * 1000.0 / calls;
+    return result;
+}
+
 void FisheyeLens::update(const ofTexture &videoTexture) {
+    updateWarp(videoTexture.getWidth(), videoTexture.getHeight());
+    
+    if (!distortedFrame.isAllocated() || distortedFrame.getWidth() != videoTexture.getWidth() ||
+        distortedFrame.getHeight() != videoTexture.getHeight()) {
+        distortedFrame.allocate(videoTexture.getWidth(), videoTexture.getHeight(), GL_RGBA);
+    }
+    distortedFrame.begin();
+    ofClear(0, 0, 0, 255);
+    drawWarp(videoTexture);
+    distortedFrame.end();
+}
+
+void FisheyeLens::updateWarp(int width, int height) {
+    PROFILE_SCOPE("fisheye warp");
     float deltaTime = ofGetLastFrameTime();
     timeCounter += deltaTime;
     
@@ -65,79 +195,142 @@ void FisheyeLens::update(const ofTexture &videoTexture) {
     // Calculate combined distortion with all effects
     float finalDistortion = calculateFinalDistortion();
     
-    int width = videoTexture.getWidth();
-    int height = videoTexture.getHeight();
-    float maxDim = std::max(width, height);
-    float scaleX = (float)width / maxDim;
-    float scaleY = (float)height / maxDim;
+    // Topology only changes with the frame size or grid step
+    if (width != meshWidth || height != meshHeight) {
+        buildMesh(width, height);
+    }
+    
+    // Sinusoidal vibration for visual shaking (the same for every vertex)
+    float vibration = vibrationAmount * sin(timeCounter * vibrationSpeed * 10.0f);
+    
+    // Texcoords only need recomputing when something that shapes the warp has moved
+    if (warpChanged(finalDistortion, vibration)) {
+        updateTexCoords(width, height, finalDistortion, vibration);
+    }
+}
 
-    distortedFrame.begin();
-    ofClear(0, 0, 0, 255);
+void FisheyeLens::drawWarp(const ofTexture &texture, float width, float height) {
+    PROFILE_SCOPE("fisheye draw");
+    int textureWidth = texture.getWidth();
+    int textureHeight = texture.getHeight();
+    if (textureWidth != meshWidth || textureHeight != meshHeight) {
+        // The texture changed size since updateWarp - same warp, rebuilt for this size
+        buildMesh(textureWidth, textureHeight);
+        updateTexCoords(textureWidth, textureHeight, lastDistortion, lastVibration);
+    }
+    
+    // Vertices sit on the plain grid, the movement offset is applied as a translation.
+    // The mesh is in texture pixels, scaled to the target size here.
+    ofPushMatrix();
+    if (width > 0 && height > 0) {
+        ofScale(width / textureWidth, height / textureHeight);
+    }
+    ofTranslate(currentOffset.x, currentOffset.y);
+    texture.bind();
+    warpMesh.draw();
+    texture.unbind();
+    ofPopMatrix();
+}
 
-    ofMesh mesh;
-    mesh.setMode(OF_PRIMITIVE_TRIANGLES);
-
-    int step = 10;
-    // Mesh grid with distortion to each point
-    for (int y = 0; y < height - step; y += step) {
-        for (int x = 0; x < width - step; x += step) {
-            for (int dy = 0; dy <= step; dy += step) {
-                for (int dx = 0; dx <= step; dx += step) {
-                    float srcX = x + dx + currentOffset.x;
-                    float srcY = y + dy + currentOffset.y;
-                    
-                    // Normalise coordinates to [-1, 1] with aspect ratio preserved
-                    float nx = ((srcX / width) * 2.0f - 1.0f) / scaleX;
-                    float ny = ((srcY / height) * 2.0f - 1.0f) / scaleY;
-                    
-                    // Calculate radial distance from center
-                    float r = sqrt(nx * nx + ny * ny);
-                    // Sinusoidal vibration for visual shaking
-                    float vibration = vibrationAmount * sin(timeCounter * vibrationSpeed * 10.0f);
-                    
-                    // Extreme fisheye distortion at high bass
-                    float theta = atan(r);
-                    float distortedR = (r > 0.0f) ? theta / r : 1.0f;
-                    
-                    // Apply all distortion effects
-                    distortedR = 1.0 + finalDistortion * (distortedR - 1.0) * (1.0 + vibration);
-                    
-                    // Adds pulse distortion
-                    if (currentPulseStrength > 0.0f) {
-                        float pulseDistort = currentPulseStrength * 0.5f * sin(r * PI * 2.0f);
-                        distortedR += pulseDistort;
-                    }
-                    
-                    // Converts distorted radial coordinates back to screen space
-                    float distortedX = nx * distortedR;
-                    float distortedY = ny * distortedR;
-                    
-                    // Bring back to 0 width, 0 height space
-                    float u = ((distortedX * scaleX) + 1.0f) * 0.5f * width;
-                    float v = ((distortedY * scaleY) + 1.0f) * 0.5f * height;
-                    
-                    mesh.addVertex(glm::vec3(srcX, srcY, 0));
-                    mesh.addTexCoord(glm::vec2(u, v));
-                }
-            }
+void FisheyeLens::buildMesh(int width, int height) {
+    meshWidth = width;
+    meshHeight = height;
+    warpMesh.clear();
+    warpMesh.setMode(OF_PRIMITIVE_TRIANGLES);
+    warpMesh.setUsage(GL_DYNAMIC_DRAW); // texcoords are re-uploaded when they change
+    texCoordsValid = false;
+    
+    // Same cells as before (x < width - step), but corners are shared between neighbours
+    int columns = 0;
+    int rows = 0;
+    for (int x = 0; x < width - gridStep; x += gridStep) columns++;
+    for (int y = 0; y < height - gridStep; y += gridStep) rows++;
+    if (columns == 0 || rows == 0) return;
+    
+    for (int row = 0; row <= rows; row++) {
+        for (int column = 0; column <= columns; column++) {
+            warpMesh.addVertex(glm::vec3(column * gridStep, row * gridStep, 0));
+            warpMesh.addTexCoord(glm::vec2(0, 0));
+        }
+    }
+    
+    // Two triangles per grid cell
+    int stride = columns + 1;
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            ofIndexType topLeft = row * stride + column;
+            ofIndexType topRight = topLeft + 1;
+            ofIndexType bottomLeft = topLeft + stride;
+            ofIndexType bottomRight = bottomLeft + 1;
             
-            // Creates triangles from vertices (2 per grid cell)
-            int i = mesh.getNumVertices();
-            mesh.addIndex(i - 4);
-            mesh.addIndex(i - 3);
-            mesh.addIndex(i - 2);
+            warpMesh.addIndex(topLeft);
+            warpMesh.addIndex(topRight);
+            warpMesh.addIndex(bottomLeft);
             
-            mesh.addIndex(i - 4);
-            mesh.addIndex(i - 2);
-            mesh.addIndex(i - 1);
+            warpMesh.addIndex(topRight);
+            warpMesh.addIndex(bottomRight);
+            warpMesh.addIndex(bottomLeft);
         }
     }
+}
+
+bool FisheyeLens::warpChanged(float finalDistortion, float vibration) const {
+    const float epsilon = 1e-4f;
+    return !texCoordsValid ||
+        fabs(finalDistortion - lastDistortion) > epsilon ||
+        fabs(vibration - lastVibration) > epsilon ||
+        fabs(currentPulseStrength - lastPulseStrength) > epsilon ||
+        currentOffset.distance(lastOffset) > 0.01f; // offset is in pixels
+}
+
+void FisheyeLens::updateTexCoords(int width, int height, float finalDistortion, float vibration) {
+    ALLOCATION_FREE_SCOPE("fisheye texcoords"); // the mesh is only rebuilt in buildMesh
+    float maxDim = std::max(width, height);
+    float scaleX = (float)width / maxDim;
+    float scaleY = (float)height / maxDim;
     
-    videoTexture.bind();
-    mesh.draw();
-    videoTexture.unbind();
+    const vector<glm::vec3>& vertices = warpMesh.getVertices();
+    vector<glm::vec2>& texCoords = warpMesh.getTexCoords(); // marks only the texcoords for upload
     
-    distortedFrame.end();
+    // Distort each grid point
+    for (size_t i = 0; i < vertices.size(); i++) {
+        float srcX = vertices[i].x + currentOffset.x;
+        float srcY = vertices[i].y + currentOffset.y;
+        
+        // Normalise coordinates to [-1, 1] with aspect ratio preserved
+        float nx = ((srcX / width) * 2.0f - 1.0f) / scaleX;
+        float ny = ((srcY / height) * 2.0f - 1.0f) / scaleY;
+        
+        // Calculate radial distance from center
+        float r = sqrt(nx * nx + ny * ny);
+        
+        // Extreme fisheye distortion at high bass - atan(r) / r from the lookup table
+        float distortedR = lookupThetaOverR(r);
+        
+        // Apply all distortion effects
+        distortedR = 1.0 + finalDistortion * (distortedR - 1.0) * (1.0 + vibration);
+        
+        // Adds pulse distortion
+        if (currentPulseStrength > 0.0f) {
+            float pulseDistort = currentPulseStrength * 0.5f * lookupPulseSine(r);
+            distortedR += pulseDistort;
+        }
+        
+        // Converts distorted radial coordinates back to screen space
+        float distortedX = nx * distortedR;
+        float distortedY = ny * distortedR;
+        
+        // Bring back to 0 width, 0 height space
+        float u = ((distortedX * scaleX) + 1.0f) * 0.5f * width;
+        float v = ((distortedY * scaleY) + 1.0f) * 0.5f * height;
+        texCoords[i] = glm::vec2(u, v);
+    }
+    
+    lastDistortion = finalDistortion;
+    lastVibration = vibration;
+    lastPulseStrength = currentPulseStrength;
+    lastOffset = currentOffset;
+    texCoordsValid = true;
 }
 
 void FisheyeLens::updatePulsing(float deltaTime) {
@@ -8,6 +8,10 @@ public:
     void update(const ofTexture &videoTexture);
     void apply(float x, float y, float width, float height);
     
+    // update() in two halves, for drawing the warp of any texture into the current target
+    void updateWarp(int width, int height);    // advances the pulse/movement and refreshes the mesh
+    void drawWarp(const ofTexture &texture, float width = 0, float height = 0); // 0 = the texture's size
+    
     void setDistortionStrength(float strength);
     float getDistortionStrength() const;
     
@@ -16,6 +20,20 @@ public:
     void setPulseFrequency(float freq); // How often pulses occur at max bass
     void setMaxDistortion(float max); // Maximum possible distortion
     
+    // Mesh resolution in pixels - bigger steps trade warp quality for CPU time
+    void setGridStep(int step);
+    int getGridStep() const;
+    
+    // Times the per-vertex warp terms with libm vs the radial lookup table on a width x height grid
+    struct WarpBenchmark {
+        int step;
+        int vertices;
+        double libmNanos;   // ns per vertex
+        double lutNanos;    // ns per vertex
+        float maxError;     // largest difference in theta / r or the pulse sine
+    };
+    WarpBenchmark benchmarkRadialLut(int width, int height, int step, int iterations = 20);
+    
     void reset();
     
 private:
@@ -46,8 +64,32 @@ private:
     float vibrationAmount;
     float vibrationSpeed;
     
+    // Cached warp mesh - topology is built once per size/step, only texcoords change per frame
+    ofVboMesh warpMesh;
+    int gridStep;
+    int meshWidth;
+    int meshHeight;
+    bool texCoordsValid;
+    // Values the current texcoords were computed from
+    float lastDistortion;
+    float lastVibration;
+    float lastPulseStrength;
+    ofVec2f lastOffset;
+    
+    // Radial lookup tables - atan(r) / r and sin(r * 2PI) only depend on r
+    std::vector<float> thetaOverRTable;
+    std::vector<float> pulseSineTable;
+    float lutMaxRadius;
+    float lutScale;  // table entries per unit of r
+    
     // Internal methods
     void updatePulsing(float deltaTime);
     void updateMovement(float deltaTime);
     float calculateFinalDistortion(); // Changed return type from void to float
+    void buildMesh(int width, int height);
+    bool warpChanged(float finalDistortion, float vibration) const;
+    void updateTexCoords(int width, int height, float finalDistortion, float vibration);
+    void buildRadialLut(float maxRadius, int size);
+    float lookupThetaOverR(float r) const;
+    float lookupPulseSine(float r) const;
 };
@@ -0,0 +1,322 @@
+//
+//  FrameProfiler.cpp
+//  visual-soundfx-test2
+//
+
+#include "FrameProfiler.hpp"
+#include "AllocationCounter.hpp"
+
+FrameProfiler &FrameProfiler::get() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+void FrameProfiler::setup() {
+#ifdef GL_TIME_ELAPSED
+    gpuTimersSupported = ofGLCheckExtension("GL_ARB_timer_query") ||
+                         ofGetGLMajorVersion() > 3 || (ofGetGLMajorVersion() == 3 && ofGetGLMinorVersion() >= 3);
+#endif
+    ofLog() << "Profiler: GPU timers " << (gpuTimersSupported ? "available" : "not available, CPU only");
+}
+
+void FrameProfiler::setEnabled(bool _enabled) {
+    if (enabled == _enabled) return;
+    enabled = _enabled;
+
+    // Frame intervals across the off period would be meaningless
+    lastFrameStartMicros = 0;
+    // Grown up front so recording doesn't show up in the allocation counts
+    if (enabled && tracing) trace.reserve(maxTraceEvents);
+    depth = 0;
+    activeGpuSection = -1;
+}
+
+void FrameProfiler::setOverlayVisible(bool visible) {
+    overlayVisible = visible;
+    overlayUpdatedMillis = 0;
+}
+
+void FrameProfiler::setTracing(bool _tracing) {
+    tracing = _tracing;
+}
+
+int FrameProfiler::addSection(const std::string &name, bool gpu) {
+    for (int i = 0; i < (int)sections.size(); i++) {
+        if (sections[i].name == name) {
+            sections[i].gpu = sections[i].gpu || gpu;
+            return i;
+        }
+    }
+
+    Section section;
+    section.name = name;
+    section.gpu = gpu;
+    section.cpu.samples.resize(historySize);
+    section.gpuTimes.samples.resize(historySize);
+    sections.push_back(section);
+    return sections.size() - 1;
+}
+
+void FrameProfiler::nextFrame() {
+    lastFrameCopies = frameCopies - frameStartCopies;
+    frameStartCopies = frameCopies;
+    if (!enabled) return;
+
+    if (lastFrameStartMicros > 0) {
+        for (auto &section : sections) {
+            if (section.calls > 0) {
+                section.cpu.add(section.frameMicros / 1000.0f);
+                section.frameMicros = 0;
+                section.calls = 0;
+            }
+            if (section.gpu) collectGpuResults(section);
+        }
+        framesRecorded++;
+    }
+
+    uint64_t now = ofGetElapsedTimeMicros();
+    uint64_t allocations = AllocationCounter::getThreadCount();
+    if (frameTimes.samples.empty()) {
+        frameTimes.samples.resize(historySize);
+        frameAllocations.samples.resize(historySize);
+        frameCopyCounts.samples.resize(historySize);
+    }
+    if (lastFrameStartMicros > 0) {
+        frameTimes.add((now - lastFrameStartMicros) / 1000.0f);
+        frameAllocations.add(allocations - lastFrameAllocations);
+        frameCopyCounts.add(lastFrameCopies);
+    }
+    lastFrameStartMicros = now;
+    lastFrameAllocations = allocations;
+}
+
+void FrameProfiler::begin(int index) {
+    Section &section = sections[index];
+    if (section.calls == 0 && section.cpu.count == 0) section.depth = depth;
+    depth++;
+
+#ifdef GL_TIME_ELAPSED
+    // Only one GL_TIME_ELAPSED query can be open at a time
+    if (section.gpu && gpuTimersSupported && activeGpuSection < 0) {
+        int slot = framesRecorded % 4;
+        if (!section.pending[slot]) {
+            if (section.queries[slot] == 0) glGenQueries(4, section.queries);
+            section.queryStartMicros[slot] = ofGetElapsedTimeMicros();
+            glBeginQuery(GL_TIME_ELAPSED, section.queries[slot]);
+            section.activeQuery = slot;
+            activeGpuSection = index;
+        }
+    }
+#endif
+
+    section.startMicros = ofGetElapsedTimeMicros();
+}
+
+void FrameProfiler::end(int index) {
+    uint64_t now = ofGetElapsedTimeMicros();
+    Section &section = sections[index];
+    uint64_t duration = now - section.startMicros;
+    section.frameMicros += duration;
+    section.calls++;
+    depth = std::max(depth - 1, 0);
+
+#ifdef GL_TIME_ELAPSED
+    if (activeGpuSection == index && section.activeQuery >= 0) {
+        glEndQuery(GL_TIME_ELAPSED);
+        section.pending[section.activeQuery] = true;
+        section.activeQuery = -1;
+        activeGpuSection = -1;
+    }
+#endif
+
+    if (tracing) {
+        if (trace.size() < maxTraceEvents) {
+            trace.push_back({index, section.startMicros, duration, false});
+        } else if (!traceFullLogged) {
+            ofLogWarning("FrameProfiler") << "Trace is full (" << maxTraceEvents << " events), only the histograms keep updating";
+            traceFullLogged = true;
+        }
+    }
+}
+
+void FrameProfiler::collectGpuResults(Section &section) {
+#ifdef GL_TIME_ELAPSED
+    for (int slot = 0; slot < 4; slot++) {
+        if (!section.pending[slot]) continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(section.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        GLuint64 nanos = 0;
+        glGetQueryObjectui64v(section.queries[slot], GL_QUERY_RESULT, &nanos);
+        section.pending[slot] = false;
+        section.gpuTimes.add(nanos / 1000000.0f);
+
+        if (tracing && trace.size() < maxTraceEvents) {
+            trace.push_back({(int)(&section - &sections[0]), section.queryStartMicros[slot], nanos / 1000, true});
+        }
+    }
+#endif
+}
+
+void FrameProfiler::History::add(float ms) {
+    samples[next] = ms;
+    next = (next + 1) % samples.size();
+    count = std::min(count + 1, (int)samples.size());
+}
+
+FrameProfiler::Percentiles FrameProfiler::History::percentiles() const {
+    Percentiles result;
+    if (count == 0) return result;
+
+    std::vector<float> sorted(samples.begin(), samples.begin() + count);
+    std::sort(sorted.begin(), sorted.end());
+
+    auto at = [&](float fraction) {
+        return sorted[std::min((int)(fraction * count), count - 1)];
+    };
+    result.p50 = at(0.50f);
+    result.p95 = at(0.95f);
+    result.p99 = at(0.99f);
+    result.max = sorted.back();
+    float sum = 0.0f;
+    for (float ms : sorted) sum += ms;
+    result.mean = sum / count;
+    result.samples = count;
+    return result;
+}
+
+FrameProfiler::Percentiles FrameProfiler::getCpuPercentiles(int section) const {
+    return sections[section].cpu.percentiles();
+}
+
+FrameProfiler::Percentiles FrameProfiler::getGpuPercentiles(int section) const {
+    return sections[section].gpuTimes.percentiles();
+}
+
+FrameProfiler::Percentiles FrameProfiler::getFramePercentiles() const {
+    return frameTimes.percentiles();
+}
+
+FrameProfiler::Percentiles FrameProfiler::getAllocationPercentiles() const {
+    return frameAllocations.percentiles();
+}
+
+FrameProfiler::Percentiles FrameProfiler::getCopyPercentiles() const {
+    return frameCopyCounts.percentiles();
+}
+
+void FrameProfiler::drawOverlay(float x, float y) {
+    if (!overlayVisible) return;
+
+    uint64_t now = ofGetElapsedTimeMillis();
+    if (overlayText.empty() || now - overlayUpdatedMillis > 500) {
+        overlayUpdatedMillis = now;
+
+        Percentiles frame = getFramePercentiles();
+        std::ostringstream text;
+        text << (enabled ? "" : "[paused] ") << "frame  p50 " << ofToString(frame.p50, 2) << "  p95 " << ofToString(frame.p95, 2)
+             << "  p99 " << ofToString(frame.p99, 2) << " ms  (" << ofToString(ofGetFrameRate(), 1) << " fps)\n";
+        if (AllocationCounter::isCounting()) {
+            Percentiles allocations = getAllocationPercentiles();
+            text << "allocations/frame  p50 " << allocations.p50 << "  p99 " << allocations.p99 << "  max " << allocations.max << "\n";
+        }
+        Percentiles copies = getCopyPercentiles();
+        text << "full-frame copies/frame  p50 " << copies.p50 << "  p99 " << copies.p99 << "  max " << copies.max << "\n";
+        text << "section                    cpu p50 / p95 / p99      gpu p50 / p95 / p99\n";
+
+        for (int i = 0; i < (int)sections.size(); i++) {
+            const Section &section = sections[i];
+            Percentiles cpu = section.cpu.percentiles();
+            if (cpu.samples == 0) continue;
+
+            std::string name = std::string(section.depth * 2, ' ') + section.name;
+            name.resize(26, ' ');
+            text << name << " " << ofToString(cpu.p50, 2, 6, ' ') << " " << ofToString(cpu.p95, 2, 6, ' ')
+                 << " " << ofToString(cpu.p99, 2, 6, ' ');
+            if (section.gpu && section.gpuTimes.count > 0) {
+                Percentiles gpu = section.gpuTimes.percentiles();
+                text << "     " << ofToString(gpu.p50, 2, 6, ' ') << " " << ofToString(gpu.p95, 2, 6, ' ')
+                     << " " << ofToString(gpu.p99, 2, 6, ' ');
+            }
+            text << "\n";
+        }
+        overlayText = text.str();
+    }
+
+    ofDrawBitmapStringHighlight(overlayText, x, y);
+}
+
+bool FrameProfiler::saveCsv(const std::string &path) const {
+    ofBuffer buffer;
+    buffer.append("section,kind,depth,samples,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+
+    auto row = [&](const std::string &name, const std::string &kind, int sectionDepth, const Percentiles &p) {
+        buffer.append(name + "," + kind + "," + ofToString(sectionDepth) + "," + ofToString(p.samples) + "," +
+                      ofToString(p.mean, 4) + "," + ofToString(p.p50, 4) + "," + ofToString(p.p95, 4) + "," +
+                      ofToString(p.p99, 4) + "," + ofToString(p.max, 4) + "\n");
+    };
+
+    row("frame", "interval", 0, getFramePercentiles());
+    if (AllocationCounter::isCounting()) row("allocations", "count", 0, getAllocationPercentiles());
+    row("frame copies", "count", 0, getCopyPercentiles());
+    for (const auto &section : sections) {
+        if (section.cpu.count > 0) row(section.name, "cpu", section.depth, section.cpu.percentiles());
+        if (section.gpuTimes.count > 0) row(section.name, "gpu", section.depth, section.gpuTimes.percentiles());
+    }
+
+    bool saved = ofBufferToFile(path, buffer);
+    ofLog() << "Profiler summary saved to " << path;
+    return saved;
+}
+
+bool FrameProfiler::saveChromeTrace(const std::string &path) const {
+    std::ofstream file(ofToDataPath(path, true));
+    if (!file.is_open()) {
+        ofLogError("FrameProfiler") << "Can't write " << path;
+        return false;
+    }
+
+    // Complete ("X") events in microseconds, CPU on tid 1 and GPU on tid 2
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (const auto &event : trace) {
+        file << ",\n{\"name\":\"" << sections[event.section].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+             << (event.gpu ? 2 : 1) << ",\"ts\":" << event.startMicros << ",\"dur\":" << event.durationMicros << "}";
+    }
+    file << "\n]}\n";
+
+    ofLog() << "Profiler trace (" << trace.size() << " events) saved to " << path;
+    return true;
+}
+
+FrameProfiler::OverheadBenchmark FrameProfiler::benchmarkOverhead(int iterations) {
+    OverheadBenchmark result;
+    int section = addSection("profiler overhead");
+    bool wasEnabled = enabled;
+    bool wasTracing = tracing;
+    tracing = false;
+
+    enabled = false;
+    uint64_t start = ofGetElapsedTimeMicros();
+    for (int i = 0; i < iterations; i++) {
+        Scope scope(section);
+    }
+    result.disabledNanos = (ofGetElapsedTimeMicros() - start) * 1000.0 / iterations;
+
+    enabled = true;
+    start = ofGetElapsedTimeMicros();
+    for (int i = 0; i < iterations; i++) {
+        Scope scope(section);
+    }
+    result.enabledNanos = (ofGetElapsedTimeMicros() - start) * 1000.0 / iterations;
+
+    // Keep the benchmark's own calls out of the frame stats
+    sections[section].frameMicros = 0;
+    sections[section].calls = 0;
+    enabled = wasEnabled;
+    tracing = wasTracing;
+    return result;
+}
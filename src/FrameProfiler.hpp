@@ -0,0 +1,167 @@
+//
+//  FrameProfiler.hpp
+//  visual-soundfx-test2
+//
+//  Scoped CPU timers (plus GL timer queries where the driver has them) for seeing where a
+//  frame's time goes. Each section keeps a rolling window of per-frame totals for p50/p95/p99,
+//  shown on an overlay ('p') and written out as CSV + Chrome trace JSON on exit.
+//
+//  Main thread only. When disabled a scope is one branch, so the timers can stay in the code.
+//
+//  PROFILE_SCOPE("name")      CPU time of the enclosing block
+//  PROFILE_GPU_SCOPE("name")  CPU time plus GPU time of the GL work issued in the block
+//                             (GL queries can't nest - an inner GPU scope only gets CPU time)
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class FrameProfiler {
+public:
+    static FrameProfiler &get();
+
+    // Checks for timer query support, needs the GL context
+    void setup();
+
+    void setEnabled(bool _enabled);
+    bool isEnabled() const { return enabled; }
+    void setOverlayVisible(bool visible);
+    bool isOverlayVisible() const { return overlayVisible; }
+    // Keeps every scope as a trace event for saveChromeTrace (capped, see maxTraceEvents)
+    void setTracing(bool _tracing);
+
+    // Section ids are handed out once per call site by the macros
+    int addSection(const std::string &name, bool gpu = false);
+
+    // Closes the previous frame's totals and starts the next, call first thing in update()
+    void nextFrame();
+
+    void begin(int section);
+    void end(int section);
+
+    struct Percentiles {
+        float p50 = 0.0f;   // ms
+        float p95 = 0.0f;
+        float p99 = 0.0f;
+        float max = 0.0f;
+        float mean = 0.0f;
+        int samples = 0;
+    };
+    Percentiles getCpuPercentiles(int section) const;
+    Percentiles getGpuPercentiles(int section) const;
+    Percentiles getFramePercentiles() const;
+    Percentiles getAllocationPercentiles() const;   // allocations per frame
+    Percentiles getCopyPercentiles() const;         // full-frame copies per frame
+
+    // One full-frame texture pass (upload, blit, effect pass). Counted even while disabled,
+    // it's a single increment
+    void countFrameCopy() { frameCopies++; }
+    int getLastFrameCopies() const { return lastFrameCopies; }
+
+    void drawOverlay(float x, float y);
+
+    // Summary of every section, one row each
+    bool saveCsv(const std::string &path) const;
+    // chrome://tracing / Perfetto format, GPU times go on a second track
+    bool saveChromeTrace(const std::string &path) const;
+    bool hasData() const { return framesRecorded > 0; }
+
+    // Times the scope on its own to check the disabled cost
+    struct OverheadBenchmark {
+        double disabledNanos;   // per scope
+        double enabledNanos;
+    };
+    OverheadBenchmark benchmarkOverhead(int iterations = 1000000);
+
+    class Scope {
+    public:
+        Scope(int _section) : section(get().isEnabled() ? _section : -1) {
+            if (section >= 0) get().begin(section);
+        }
+        ~Scope() {
+            if (section >= 0) get().end(section);
+        }
+    private:
+        int section;
+    };
+
+private:
+    FrameProfiler() {}
+
+    // Last historySize frames of one measurement, in ms
+    struct History {
+        std::vector<float> samples;
+        int next = 0;
+        int count = 0;
+        void add(float ms);
+        Percentiles percentiles() const;
+    };
+
+    struct Section {
+        std::string name;
+        bool gpu = false;
+        int depth = 0;              // nesting depth the first time it ran, for the overlay
+
+        uint64_t startMicros = 0;
+        uint64_t frameMicros = 0;   // summed over every call this frame
+        int calls = 0;
+        History cpu;
+
+        // GL_TIME_ELAPSED queries, a few frames in flight so the result never stalls the pipeline
+        GLuint queries[4] = {0, 0, 0, 0};
+        bool pending[4] = {false, false, false, false};
+        uint64_t queryStartMicros[4] = {0, 0, 0, 0};
+        int activeQuery = -1;
+        History gpuTimes;
+    };
+
+    struct TraceEvent {
+        int section;
+        uint64_t startMicros;
+        uint64_t durationMicros;
+        bool gpu;
+    };
+
+    void collectGpuResults(Section &section);
+
+    static const int historySize = 600;             // ~10s at 60fps
+    static const size_t maxTraceEvents = 1000000;
+
+    bool enabled = false;
+    bool overlayVisible = false;
+    bool tracing = true;
+    bool gpuTimersSupported = false;
+
+    std::vector<Section> sections;
+    int depth = 0;
+    int activeGpuSection = -1;
+
+    uint64_t lastFrameStartMicros = 0;
+    int framesRecorded = 0;
+    History frameTimes;     // start of one frame to the start of the next
+    History frameAllocations;   // main thread heap allocations per frame (counts, not ms)
+    uint64_t lastFrameAllocations = 0;
+    History frameCopyCounts;    // full-frame copies per frame (counts, not ms)
+    uint64_t frameCopies = 0;
+    uint64_t frameStartCopies = 0;
+    int lastFrameCopies = 0;
+
+    std::vector<TraceEvent> trace;
+    bool traceFullLogged = false;
+
+    // Overlay text, rebuilt twice a second so it stays readable and cheap
+    std::string overlayText;
+    uint64_t overlayUpdatedMillis = 0;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) \
+    static const int PROFILE_CONCAT(profileSection, __LINE__) = FrameProfiler::get().addSection(name); \
+    FrameProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSection, __LINE__))
+
+#define PROFILE_GPU_SCOPE(name) \
+    static const int PROFILE_CONCAT(profileSection, __LINE__) = FrameProfiler::get().addSection(name, true); \
+    FrameProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(PROFILE_CONCAT(profileSection, __LINE__))
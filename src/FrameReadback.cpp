@@ -0,0 +1,142 @@
+//
+//  FrameReadback.cpp
+//  visual-soundfx-test2
+//
+
+#include "FrameReadback.hpp"
+#include "FrameProfiler.hpp"
+
+FrameReadback::FrameReadback() {
+    writeIndex = 0;
+    bufferWidth = 0;
+    bufferHeight = 0;
+    frameCounter = 0;
+    pixelsFrame = 0;
+    frameReady = false;
+    useAsync = true;
+}
+
+void FrameReadback::setup() {
+#ifdef TARGET_OPENGLES
+    // No glGetTexImage into pixel buffers on GLES - always read back synchronously
+    useAsync = false;
+#else
+    // Pixel buffer objects are core since GL 2.1 (Mesa llvmpipe included)
+    bool hasPixelBuffers = ofGLCheckExtension("GL_ARB_pixel_buffer_object") ||
+                           ofGetGLMajorVersion() > 2 ||
+                           (ofGetGLMajorVersion() == 2 && ofGetGLMinorVersion() >= 1);
+    useAsync = useAsync && hasPixelBuffers;
+#endif
+
+    clear();
+    ofLog() << "FrameReadback: " << (useAsync ? "async pixel buffer ring of " + ofToString(numBuffers) : std::string("synchronous fallback"));
+}
+
+void FrameReadback::allocateBuffers(int width, int height) {
+    pixelBuffers.resize(numBuffers);
+    bufferFrames.assign(numBuffers, 0);
+    bufferPending.assign(numBuffers, false);
+
+    for (auto &buffer : pixelBuffers) {
+        buffer.allocate((size_t)width * height * 4, GL_STREAM_READ);
+    }
+
+    pixels.allocate(width, height, OF_PIXELS_RGBA);
+    bufferWidth = width;
+    bufferHeight = height;
+    writeIndex = 0;
+    frameReady = false;
+}
+
+void FrameReadback::update(const ofTexture &tex) {
+    PROFILE_SCOPE("readback");
+    if (!tex.isAllocated()) return;
+    frameCounter++;
+
+    // Fallback - read straight into the pixels, blocking until the GPU is done
+    if (!useAsync) {
+        tex.readToPixels(pixels);
+        pixelsFrame = frameCounter;
+        frameReady = true;
+        return;
+    }
+
+    int width = tex.getWidth();
+    int height = tex.getHeight();
+    if (width != bufferWidth || height != bufferHeight || pixelBuffers.empty()) {
+        allocateBuffers(width, height);
+    }
+
+    // Not polled since it was queued - take it now rather than write over it
+    if (bufferPending[writeIndex]) {
+        mapBuffer(writeIndex);
+    }
+
+    // Queue this frame's readback - returns straight away, the copy happens on the GPU
+    tex.copyTo(pixelBuffers[writeIndex]);
+    bufferFrames[writeIndex] = frameCounter;
+    bufferPending[writeIndex] = true;
+
+    writeIndex = (writeIndex + 1) % numBuffers;
+}
+
+bool FrameReadback::poll() {
+    if (!useAsync || pixelBuffers.empty()) return false;
+
+    // The newest pending readback, queued on an earlier frame (one frame of latency)
+    int newest = -1;
+    for (int i = 0; i < numBuffers; i++) {
+        if (bufferPending[i] && (newest < 0 || bufferFrames[i] > bufferFrames[newest])) newest = i;
+    }
+    if (newest < 0) return false;
+    PROFILE_SCOPE("readback map");
+    mapBuffer(newest);
+    return true;
+}
+
+void FrameReadback::mapBuffer(int index) {
+    const unsigned char *data = pixelBuffers[index].map<unsigned char>(GL_READ_ONLY);
+    if (data) {
+        memcpy(pixels.getData(), data, pixels.getTotalBytes());
+        pixelsFrame = bufferFrames[index];
+        frameReady = true;
+    }
+    pixelBuffers[index].unmap();
+    // Anything older than this one is out of date now
+    for (int i = 0; i < numBuffers; i++) {
+        if (bufferFrames[i] <= bufferFrames[index]) bufferPending[i] = false;
+    }
+}
+
+void FrameReadback::clear() {
+    pixelBuffers.clear();
+    bufferFrames.clear();
+    bufferPending.clear();
+    bufferWidth = 0;
+    bufferHeight = 0;
+    writeIndex = 0;
+    frameReady = false;
+}
+
+bool FrameReadback::isFrameReady() const {
+    return frameReady;
+}
+
+const ofPixels& FrameReadback::getPixels() const {
+    return pixels;
+}
+
+uint64_t FrameReadback::getFrameNumber() const {
+    return pixelsFrame;
+}
+
+void FrameReadback::setUseAsync(bool async) {
+    if (useAsync != async) {
+        useAsync = async;
+        clear();
+    }
+}
+
+bool FrameReadback::isUsingAsync() const {
+    return useAsync;
+}
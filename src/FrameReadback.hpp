@@ -0,0 +1,55 @@
+//
+//  FrameReadback.hpp
+//  visual-soundfx-test2
+//
+//  Shared GPU -> CPU readback for the effects that work on pixels (MotionBlur, GlitchEffect).
+//  Keeps two pixel pack buffers so the readback queued on one app frame is only mapped at
+//  the start of the next (poll), instead of stalling the main thread while the driver flushes.
+//  It's mapped whether or not another readback is queued, so the last frame of a paused or
+//  stalled clip still arrives. A third buffer would only add a frame of lag.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class FrameReadback {
+public:
+    FrameReadback();
+
+    void setup();
+    // Call at the start of every app frame - maps the readback queued on an earlier frame,
+    // true if new pixels arrived
+    bool poll();
+    // Queues a readback of tex (in the synchronous fallback its pixels are there straight away)
+    void update(const ofTexture &tex);
+    void clear();
+
+    // True once at least one readback has completed
+    bool isFrameReady() const;
+    const ofPixels& getPixels() const;
+    // Number of the update() call the current pixels came from
+    uint64_t getFrameNumber() const;
+
+    // Async (pixel buffer) path - falls back to a plain readToPixels when unsupported
+    void setUseAsync(bool async);
+    bool isUsingAsync() const;
+
+private:
+    void allocateBuffers(int width, int height);
+    void mapBuffer(int index);
+
+    static constexpr int numBuffers = 2;
+    std::vector<ofBufferObject> pixelBuffers; // one being written, one being mapped
+    std::vector<uint64_t> bufferFrames;       // which update() each buffer holds
+    std::vector<bool> bufferPending;          // buffer has a readback queued that hasn't been mapped
+    int writeIndex;
+    int bufferWidth;
+    int bufferHeight;
+
+    ofPixels pixels;        // last completed readback handed to the effects
+    uint64_t frameCounter;  // number of update() calls so far
+    uint64_t pixelsFrame;
+    bool frameReady;
+    bool useAsync;
+};
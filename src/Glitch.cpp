@@ -1,5 +1,8 @@
 // GlitchEffect.cpp
 #include "Glitch.hpp"
+#include "FrameProfiler.hpp"
+#include "AllocationCounter.hpp"
+#include "TilePool.hpp"
 
 void GlitchEffect::setup() {
     glitchAmount = 0.5f;
@@ -7,10 +10,40 @@ void GlitchEffect::setup() {
     magnifierSize = 100.0f; // Using size for square dimensions
     magnifierStrength = 1.5f;
     lastGlitchTime = 0;
+    lastEffectsTime = -1.0f;
+    forceGlitch = false;
     glitchInterval = 100; // milliseconds between major glitches
+    
+    midRangeAmount = 0.0f;
+    highRangeAmount = 0.0f;
+    colorShiftAmount = 1.0f; // neutral until the highs drive it
+    seed = 0;
+    passCounter = 0;
+    
+    baseGlitchDuration = 0.0f;
+    magnifierDuration = 0.0f; // single frame, like the original one-shot magnifiers
+    activeGlitches.clear();
+    activeGlitches.reserve(16); // a handful live at once, so spawning doesn't allocate
+}
+
+namespace {
+    // Copies one channel of a row shifted by shift pixels, clamping at the edges like ofClamp did
+    void shiftChannel(const unsigned char* src, unsigned char* dst, int width, int channels, int channel, int shift) {
+        int start = ofClamp(-shift, 0, width);       // first x whose source is inside the row
+        int end = ofClamp(width - shift, start, width); // first x whose source is past the row
+        
+        unsigned char left = src[channel];
+        unsigned char right = src[(width - 1) * channels + channel];
+        for (int x = 0; x < start; x++) dst[x * channels + channel] = left;
+        
+        for (int x = start; x < end; x++) dst[x * channels + channel] = src[(x + shift) * channels + channel];
+        
+        for (int x = end; x < width; x++) dst[x * channels + channel] = right;
+    }
 }
 
 void GlitchEffect::update(const ofTexture& tex) {
+    PROFILE_SCOPE("glitch update");
     // Allocate if needed
     if (!fbo.isAllocated() || fbo.getWidth() != tex.getWidth() || fbo.getHeight() != tex.getHeight()) {
         fbo.allocate(tex.getWidth(), tex.getHeight());
@@ -25,140 +58,260 @@ void GlitchEffect::update(const ofTexture& tex) {
     
     // Read from FBO to buffer
     fbo.readToPixels(buffer.getPixels());
-    buffer.update();
     
+    applyEffects();
+}
+
+void GlitchEffect::update(const ofPixels& framePixels) {
+    PROFILE_SCOPE("glitch update");
+    // Skip until the readback has produced a frame
+    if (!framePixels.isAllocated()) return;
+    
+    if (!fbo.isAllocated() || fbo.getWidth() != framePixels.getWidth() || fbo.getHeight() != framePixels.getHeight()) {
+        fbo.allocate(framePixels.getWidth(), framePixels.getHeight());
+    }
+    
+    // Copy into the working buffer, no readback of our own. Sized first so the copy itself
+    // never allocates, whichever instance or frame size this is
+    buffer.getPixels().allocate(framePixels.getWidth(), framePixels.getHeight(), framePixels.getPixelFormat());
+    {
+        ALLOCATION_FREE_SCOPE("glitch copy");
+        buffer.getPixels() = framePixels;
+    }
+    
+    applyEffects();
+}
+
+void GlitchEffect::applyEffects() {
     // Apply effects to FBO
     fbo.begin();
     ofClear(0, 0, 0, 255);
     
     // apply some subtle glitching
-    applyGlitchEffect(buffer, 0.3f * glitchAmount); // Subtle continuous glitch
+    applyGlitchEffect(buffer.getPixels(), 0.3f * glitchAmount); // Subtle continuous glitch
     
     //stronger random glitches periodically
-    if (ofGetElapsedTimeMillis() - lastGlitchTime > glitchInterval) {
+    if (forceGlitch || ofGetElapsedTimeMillis() - lastGlitchTime > glitchInterval) {
+        forceGlitch = false;
+        GlitchRandom random(seed, passCounter++);
         lastGlitchTime = ofGetElapsedTimeMillis();
-        glitchInterval = ofRandom(50, 500); // Random interval for next glitch
+        glitchInterval = random.range(50, 500); // Random interval for next glitch
         
         // Strong glitch
-        applyGlitchEffect(buffer, glitchAmount);
+        applyGlitchEffect(buffer.getPixels(), glitchAmount);
         
         // Random square magnifiers (1-3 at a time)
-        int numMagnifiers = ofRandom(1, 4);
+        int numMagnifiers = random.range(1, 4);
         for (int i = 0; i < numMagnifiers; i++) {
-            applySquareMagnifierEffect(buffer);
+            spawnMagnifier(buffer.getPixels().getWidth(), buffer.getPixels().getHeight());
         }
     }
     
+    // Every live magnifier is composited in one pass, then aged by the time since the last pass -
+    // this only runs on new video frames, so the app frame time would age them too slowly
+    float now = ofGetElapsedTimef();
+    float deltaTime = (lastEffectsTime < 0.0f) ? ofGetLastFrameTime() : now - lastEffectsTime;
+    lastEffectsTime = now;
+    updateMagnifiers(deltaTime);
+    
+    buffer.update(); // single upload after all the pixel work
     buffer.draw(0, 0);
     fbo.end();
+    FrameProfiler::get().countFrameCopy();
 }
 
-void GlitchEffect::applyGlitchEffect(ofImage& img, float strength) {
-    ofPixels& pixels = img.getPixels();
-    int width = img.getWidth();
-    int height = img.getHeight();
+void GlitchEffect::applyGlitchEffect(ofPixels& pixels, float strength) {
+    int width = pixels.getWidth();
+    int height = pixels.getHeight();
+    int channels = pixels.getNumChannels();
+    if (width == 0 || height == 0 || channels < 3) return;
+    
+    size_t rowBytes = (size_t)width * channels;
+    TilePool& pool = TilePool::get();
+    rowScratch.resize(rowBytes * 2 * pool.getThreadCount()); // no-op once the frame size is stable
+    ALLOCATION_FREE_SCOPE("glitch pass");
+    
+    // Every pass draws from its own stream so results only depend on the seed
+    uint64_t pass = passCounter++;
+    GlitchRandom random(seed, pass);
     
     // Modifies the channel shifting to use colorShiftAmount
-    int shiftR = ofRandom(-15, 15) * strength * colorShiftAmount;
-    int shiftG = ofRandom(-15, 15) * strength * colorShiftAmount;
-    int shiftB = ofRandom(-15, 15) * strength * colorShiftAmount;
+    int shiftR = random.range(-15, 15) * strength * colorShiftAmount;
+    int shiftG = random.range(-15, 15) * strength * colorShiftAmount;
+    int shiftB = random.range(-15, 15) * strength * colorShiftAmount;
     
+    // Random scanline jitter - a contiguous band of rows
+    int jitterAreaHeight = random.range(10, 100) * strength;
+    int jitterY = random.range(0, std::max(height - jitterAreaHeight, 0));
+    int jitterStart = ofClamp(jitterY + 1, 0, height);
+    int jitterEnd = ofClamp(jitterY + jitterAreaHeight, jitterStart, height);
     
-    // Random scanline jitter
-    int jitterAreaHeight = ofRandom(10, 100) * strength;
-    int jitterY = ofRandom(height - jitterAreaHeight);
+    // Chance a channel gets swapped outside the band - same odds as ofRandomf() < 0.3 * strength
+    float chance = ofClamp((0.3f * strength + 1.0f) * 0.5f, 0.0f, 1.0f);
+    uint32_t threshold = chance * 65536.0f;
     
-    // Loop through each pixel
-    for (int y = 0; y < height; y++) {
+    unsigned char* data = pixels.getData();
+    
+    // Rows only read themselves and draw from their own stream, so tiles can run on any thread
+    pool.forEachTile(height, 16, [&](int rowStart, int rowEnd, int thread) {
+        unsigned char* sourceRow = rowScratch.data() + rowBytes * 2 * thread; // untouched copy of the row
+        unsigned char* shiftedRow = sourceRow + rowBytes;                     // channel-shifted sourceRow
         
-        for (int x = 0; x < width; x++) {
-            // Calculates new positions for each color channel with clamping
-            int srcXR = ofClamp(x + shiftR, 0, width-1);
-            int srcXG = ofClamp(x + shiftG, 0, width-1);
-            int srcXB = ofClamp(x + shiftB, 0, width-1);
+        for (int y = rowStart; y < rowEnd; y++) {
+            unsigned char* row = data + y * rowBytes;
+            // Read from an untouched copy so shifts never pick up already glitched pixels
+            memcpy(sourceRow, row, rowBytes);
             
-            ofColor c = pixels.getColor(x, y);
-            if (y > jitterY && y < jitterY + jitterAreaHeight) {
-                // More intense glitch in jitter area
-                c.r = pixels.getColor(srcXR, y).r;
-                c.g = pixels.getColor(ofClamp(x + shiftG*2, 0, width-1), y).g;
-                c.b = pixels.getColor(srcXB, y).b;
-            } else {
-                // Subtler glitch outside
-                if (ofRandomf() < 0.3f * strength) {
-                    c.r = pixels.getColor(srcXR, y).r;
-                }
-                if (ofRandomf() < 0.3f * strength) {
-                    c.g = pixels.getColor(srcXG, y).g;
+            if (y >= jitterStart && y < jitterEnd) {
+                // More intense glitch in jitter area - whole row shifted per channel
+                shiftChannel(sourceRow, row, width, channels, 0, shiftR);
+                shiftChannel(sourceRow, row, width, channels, 1, shiftG * 2);
+                shiftChannel(sourceRow, row, width, channels, 2, shiftB);
+                continue;
+            }
+            
+            // Subtler glitch outside - shift the whole row once, then pick per pixel with a mask
+            shiftChannel(sourceRow, shiftedRow, width, channels, 0, shiftR);
+            shiftChannel(sourceRow, shiftedRow, width, channels, 1, shiftG);
+            
+            GlitchRandom rowRandom(seed, GlitchRandom::rowStream(pass, y));
+            for (int x = 0; x < width; x += 2) {
+                // 64 bits = four 16 bit draws = red + green decisions for two pixels
+                uint64_t bits = rowRandom.next();
+                int count = std::min(2, width - x);
+                for (int i = 0; i < count; i++) {
+                    unsigned char maskR = -(unsigned char)(((bits >> (i * 32)) & 0xFFFF) < threshold);
+                    unsigned char maskG = -(unsigned char)(((bits >> (i * 32 + 16)) & 0xFFFF) < threshold);
+                    size_t index = (x + i) * channels;
+                    row[index] = (shiftedRow[index] & maskR) | (row[index] & ~maskR);
+                    row[index + 1] = (shiftedRow[index + 1] & maskG) | (row[index + 1] & ~maskG);
                 }
             }
-            pixels.setColor(x, y, c);
         }
-    }
+    });
     
+    // Block copies can overlap each other, so these stay in order on this thread
     // Random block copies to create digital tearing
     for (int i = 0; i < 5 * strength; i++) {
-        int blockW = ofRandom(10, 100);
-        int blockH = ofRandom(5, 30);
-        int srcX = ofRandom(width - blockW);
-        int srcY = ofRandom(height - blockH);
-        int destX = ofRandom(width - blockW);
-        int destY = ofRandom(height - blockH);
+        int blockW = std::min((int)random.range(10, 100), width);
+        int blockH = std::min((int)random.range(5, 30), height);
+        int srcX = random.range(0, width - blockW);
+        int srcY = random.range(0, height - blockH);
+        int destX = random.range(0, width - blockW);
+        int destY = random.range(0, height - blockH);
         
         for (int y = 0; y < blockH; y++) {
-            for (int x = 0; x < blockW; x++) {
-                // Copy pixel from source to destination
-                pixels.setColor(destX + x, destY + y, pixels.getColor(srcX + x, srcY + y));
-            }
+            // Copy a row of the block from source to destination (regions can overlap)
+            memmove(data + (destY + y) * rowBytes + destX * channels,
+                    data + (srcY + y) * rowBytes + srcX * channels,
+                    (size_t)blockW * channels);
         }
     }
+}
+
+void GlitchEffect::spawnMagnifier(int width, int height) {
+    // Random square properties
+    GlitchRandom random(seed, passCounter++);
+    GlitchElement glitch;
+    glitch.size = random.range(50, 200);                                    // Size of square effect
+    glitch.position.set(random.range(0, width), random.range(0, height));   // Random center of square
+    glitch.strength = random.range(1.2f, 2.5f);                             // Strength of zoom
+    glitch.zoomIn = random.nextFloat() > 0.75f;                             // Random zoom direction (same odds as ofRandomf() > 0.5)
+    glitch.lifetime = magnifierDuration;
+    glitch.maxLifetime = magnifierDuration;
+    glitch.isMagnifier = true;
+    activeGlitches.push_back(glitch);
+}
+
+void GlitchEffect::updateMagnifiers(float deltaTime) {
+    ofPixels& pixels = buffer.getPixels();
+    int width = pixels.getWidth();
+    int height = pixels.getHeight();
     
-    img.update();
+    if (!activeGlitches.empty() && width > 0 && height > 0) {
+        // Rows any magnifier can sample from - the zoom reaches at most (1 + strength) half sizes out
+        int rowStart = height;
+        int rowEnd = 0;
+        for (const auto& glitch : activeGlitches) {
+            float reach = glitch.size / 2 * (1.0f + glitch.strength);
+            rowStart = std::min(rowStart, (int)ofClamp(glitch.position.y - reach, 0, height));
+            rowEnd = std::max(rowEnd, (int)ofClamp(glitch.position.y + reach + 1, 0, height));
+        }
+        
+        // Snapshot just those rows (same size buffer, so no reallocation after the first frame)
+        magnifierSource.allocate(width, height, pixels.getNumChannels());
+        size_t rowBytes = (size_t)width * pixels.getNumChannels();
+        if (rowEnd > rowStart) {
+            memcpy(magnifierSource.getData() + rowStart * rowBytes, pixels.getData() + rowStart * rowBytes,
+                   (rowEnd - rowStart) * rowBytes);
+        }
+        
+        for (const auto& glitch : activeGlitches) {
+            // Eases out over the magnifier's life (full strength when it only lasts one frame)
+            float life = glitch.maxLifetime > 0 ? glitch.lifetime / glitch.maxLifetime : 1.0f;
+            applyPersistentMagnifier(glitch, glitch.strength * life);
+        }
+    }
+    
+    // Age and drop the expired ones
+    for (auto& glitch : activeGlitches) {
+        glitch.lifetime -= deltaTime;
+    }
+    activeGlitches.erase(std::remove_if(activeGlitches.begin(), activeGlitches.end(),
+                                        [](const GlitchElement& glitch) { return glitch.lifetime <= 0; }),
+                         activeGlitches.end());
 }
 
-void GlitchEffect::applySquareMagnifierEffect(ofImage& img) {
-    ofPixels& pixels = img.getPixels();
-    int width = img.getWidth();
-    int height = img.getHeight();
+void GlitchEffect::applyPersistentMagnifier(const GlitchElement& glitch, float strength) {
+    ofPixels& pixels = buffer.getPixels();
+    int width = pixels.getWidth();
+    int height = pixels.getHeight();
+    int channels = pixels.getNumChannels();
+    if (!magnifierSource.isAllocated() || magnifierSource.getWidth() != width) return;
     
-    // Random square properties
-    float size = ofRandom(50, 200);                    // Size of square effect
-    ofVec2f center(ofRandom(width), ofRandom(height)); // Random center of square
-    float strength = ofRandom(1.2f, 2.5f);             // Strength of zoom
-    bool zoomIn = ofRandomf() > 0.5f;                  // Random zoom direction
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            // Check if the current pixel is inside the distortion square
-            if (abs(x - center.x) < size/2 && abs(y - center.y) < size/2) {
+    const unsigned char* source = magnifierSource.getData();
+    unsigned char* target = pixels.getData();
+    float halfSize = glitch.size / 2;
+    const ofVec2f& center = glitch.position;
+    
+    // Only walk the square itself, clipped to the image (|x - center| < size / 2)
+    int x0 = std::max(0, (int)floor(center.x - halfSize) + 1);
+    int x1 = std::min(width - 1, (int)ceil(center.x + halfSize) - 1);
+    int y0 = std::max(0, (int)floor(center.y - halfSize) + 1);
+    int y1 = std::min(height - 1, (int)ceil(center.y + halfSize) - 1);
+    
+    // Samples come from the snapshot, so the square's rows can be split across the pool
+    TilePool::get().forEachTile(y1 - y0 + 1, 16, [&](int rowStart, int rowEnd, int) {
+        for (int y = y0 + rowStart; y < y0 + rowEnd; y++) {
+            float dy = (y - center.y) / halfSize;
+            unsigned char* row = target + (size_t)y * width * channels;
+            
+            for (int x = x0; x <= x1; x++) {
                 // Calculates distance from center
-                float dx = (x - center.x) / (size/2);
-                float dy = (y - center.y) / (size/2);
+                float dx = (x - center.x) / halfSize;
                 
                 // Square distortion based on max axis distance
                 float distortion = max(abs(dx), abs(dy));
-                float factor = zoomIn ?
+                float factor = glitch.zoomIn ?
                     (1.0 - strength * distortion) : // Zoom in
                     (1.0 + strength * (1.0 - distortion)); // Zoom out
                 
-                // Calculates new sample coordinates
-                int srcX = center.x + (x - center.x) * factor;
-                int srcY = center.y + (y - center.y) * factor;
+                // Calculates new sample coordinates, clamped to image bounds
+                int srcX = ofClamp((int)(center.x + (x - center.x) * factor), 0, width - 1);
+                int srcY = ofClamp((int)(center.y + (y - center.y) * factor), 0, height - 1);
                 
-                // Clamp coordinates to image bounds
-                     srcX = ofClamp(srcX, 0, width - 1);
-                     srcY = ofClamp(srcY, 0, height - 1);
-                     
-                     // Set pixel to distorted sample
-                     pixels.setColor(x, y, pixels.getColor(srcX, srcY));
+                // Set pixel to distorted sample from the untouched snapshot
+                const unsigned char* sample = source + ((size_t)srcY * width + srcX) * channels;
+                for (int c = 0; c < channels; c++) {
+                    row[x * channels + c] = sample[c];
+                }
             }
         }
-    }
-    
-    img.update();
+    });
 }
 
 void GlitchEffect::draw(float x, float y, float w, float h) {
+    PROFILE_SCOPE("glitch draw");
     fbo.draw(x, y, w, h);
 }
 
@@ -169,6 +322,7 @@ void GlitchEffect::reset() {
     midRangeAmount = 0.0f;
     highRangeAmount = 0.0f;
     colorShiftAmount = 0.0f;
+    activeGlitches.clear();
 }
 
 void GlitchEffect::setGlitchAmount(float amount) {
@@ -195,3 +349,28 @@ void GlitchEffect::setHighRangeAmount(float amount) {
     // Map highs to color glitch intensity
     colorShiftAmount = ofMap(highRangeAmount, 0.0f, 1.0f, 0.0f, 2.0f);
 }
+
+void GlitchEffect::setGlitchInterval(int intervalMs) {
+    glitchInterval = std::max(intervalMs, 0);
+}
+
+int GlitchEffect::getGlitchInterval() const {
+    return glitchInterval;
+}
+
+void GlitchEffect::triggerGlitch() {
+    forceGlitch = true;
+}
+
+void GlitchEffect::setMagnifierDuration(float seconds) {
+    magnifierDuration = std::max(seconds, 0.0f);
+}
+
+void GlitchEffect::setSeed(uint64_t _seed) {
+    seed = _seed;
+    passCounter = 0; // restart the sequence so a reseed replays the same glitches
+}
+
+uint64_t GlitchEffect::getSeed() const {
+    return seed;
+}
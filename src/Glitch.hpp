@@ -2,6 +2,7 @@
 
 #include "ofMain.h"
 #include "ofxOpenCv.h"
+#include "GlitchRandom.hpp"
 
 class GlitchEffect {
 public:
@@ -12,10 +13,12 @@ public:
         float lifetime;
         float maxLifetime;
         bool isMagnifier;
+        bool zoomIn;
     };
 
     void setup();
     void update(const ofTexture& tex);
+    void update(const ofPixels& framePixels); // pixels from the shared FrameReadback
     void draw(float x, float y, float w, float h);
     void reset();
     
@@ -35,10 +38,21 @@ public:
     void setMidRangeAmount(float amount); // Controls magnifiers and distortion
     void setHighRangeAmount(float amount); // Controls colour glitches
     void applyPersistentMagnifier(const GlitchElement& glitch, float strength);
+    void setMagnifierDuration(float seconds); // how long each magnifier stays (0 = a single frame)
+    void triggerGlitch(); // the next update does a strong glitch whatever the interval says
+    
+    // All glitch randomness comes from this seed, so the same seed and input give the same output
+    void setSeed(uint64_t _seed);
+    uint64_t getSeed() const;
+    
+    // Channel shift / scanline jitter / tearing on raw pixels (3 or 4 channels), no GL needed.
+    // Rows run on the TilePool - same seed, same output whatever the thread count.
+    void applyGlitchEffect(ofPixels& pixels, float strength);
 
 private:
-    void applyGlitchEffect(ofImage& img, float strength);
-    void applySquareMagnifierEffect(ofImage& img);
+    void applyEffects();
+    void spawnMagnifier(int width, int height);
+    void updateMagnifiers(float deltaTime);
     
     ofFbo fbo;                      // Framebuffer for processing
     ofImage buffer;                 // Image buffer for pixel manipulation
@@ -50,8 +64,10 @@ private:
     
     // Timing control
     int lastGlitchTime;             // Last time a major glitch occurred
+    float lastEffectsTime;          // ofGetElapsedTimef() of the last applyEffects (-1 before the first)
     int glitchInterval;             // Base interval between glitches
     int glitchCounter;              // Counter for glitch variations
+    bool forceGlitch;               // set by triggerGlitch()
     
     float midRangeAmount;
     float highRangeAmount;
@@ -61,6 +77,11 @@ private:
     ofColor magnifierBorderColor;
     int magnifierBorderSize;
     
+    uint64_t seed;                  // base seed for GlitchRandom
+    uint64_t passCounter;           // advances every glitch pass so each gets its own stream
+    vector<unsigned char> rowScratch; // source + shifted row for each TilePool thread
+    
+    ofPixels magnifierSource;       // snapshot the magnifiers sample from, so they never read each other's output
     vector<GlitchElement> activeGlitches;
     float baseGlitchDuration;
     float magnifierDuration;
@@ -0,0 +1,51 @@
+//
+//  GlitchRandom.hpp
+//  visual-soundfx-test2
+//
+//  Small counter-based random generator for the glitch kernels. Every value is a pure
+//  function of (seed, stream, counter), so a given seed always produces the same glitch
+//  no matter which order rows are processed in.
+//
+
+#pragma once
+
+#include <cstdint>
+
+class GlitchRandom {
+public:
+    GlitchRandom(uint64_t seed = 0, uint64_t stream = 0) {
+        key = mix(seed ^ mix(stream + 0x632BE59BD9B4E019ull));
+        counter = 0;
+    }
+
+    // 64 random bits
+    uint64_t next() {
+        return mix(key + (counter++) * 0x9E3779B97F4A7C15ull);
+    }
+
+    // Uniform in [0, 1)
+    float nextFloat() {
+        return (next() >> 40) * (1.0f / 16777216.0f);
+    }
+
+    // Uniform in [min, max) - same use as ofRandom(min, max)
+    float range(float min, float max) {
+        return min + (max - min) * nextFloat();
+    }
+
+    // Stream id for one row of one pass, keeps per-row randomness independent of thread count
+    static uint64_t rowStream(uint64_t pass, int row) {
+        return (pass << 32) ^ (uint32_t)row;
+    }
+
+private:
+    // splitmix64 finaliser
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key;
+    uint64_t counter;
+};
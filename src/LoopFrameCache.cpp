@@ -0,0 +1,214 @@
+//
+//  LoopFrameCache.cpp
+//  visual-soundfx-test2
+//
+
+#include "LoopFrameCache.hpp"
+#include "AllocationCounter.hpp"
+#include "FrameProfiler.hpp"
+#include "TilePool.hpp"
+
+namespace {
+    const int maxScale = 8;
+    const int minFrames = 2;
+
+    // Packed 8 bit formats only, planar decoder output isn't recorded
+    bool isRecordable(const ofPixels &frame) {
+        switch (frame.getPixelFormat()) {
+            case OF_PIXELS_GRAY:
+            case OF_PIXELS_RGB:
+            case OF_PIXELS_BGR:
+            case OF_PIXELS_RGBA:
+            case OF_PIXELS_BGRA:
+                return true;
+            default:
+                return false;
+        }
+    }
+}
+
+void LoopFrameCache::setMemoryBudget(size_t bytes) {
+    if (bytes == memoryBudget) return;
+    memoryBudget = bytes;
+    // Resized on the next frame
+    frames.clear();
+    count = 0;
+    sourceWidth = 0;
+}
+
+void LoopFrameCache::setLoopDuration(float seconds) {
+    if (seconds == loopDuration) return;
+    loopDuration = std::max(seconds, 0.0f);
+    frames.clear();
+    count = 0;
+    sourceWidth = 0;
+}
+
+void LoopFrameCache::clear() {
+    stopPlayback();
+    first = 0;
+    count = 0;
+}
+
+void LoopFrameCache::allocate(int _sourceWidth, int _sourceHeight, ofPixelFormat _format, int _channels, float _fps) {
+    sourceWidth = _sourceWidth;
+    sourceHeight = _sourceHeight;
+    format = _format;
+    channels = _channels;
+    fps = _fps;
+    first = 0;
+    count = 0;
+
+    // Enough frames for the whole loop, then the smallest downscale that fits the budget
+    int wanted = std::max((int)std::ceil(loopDuration * fps) + 1, minFrames);
+    for (scale = 1; scale < maxScale; scale++) {
+        size_t bytes = (size_t)(sourceWidth / scale) * (sourceHeight / scale) * channels;
+        if (bytes * wanted <= memoryBudget) break;
+    }
+    width = std::max(sourceWidth / scale, 1);
+    height = std::max(sourceHeight / scale, 1);
+
+    // Still too big at the smallest size - keep what fits, the loop just gets shorter
+    size_t frameBytes = (size_t)width * height * channels;
+    int capacity = std::max(std::min(wanted, (int)(memoryBudget / frameBytes)), minFrames);
+    if (capacity < wanted) {
+        ofLogWarning("LoopFrameCache") << "Budget only holds " << capacity << " of " << wanted << " frames";
+    }
+
+    frames.clear();
+    frames.resize(capacity);
+    for (auto &frame : frames) {
+        frame.pixels.allocate(width, height, format);
+    }
+    ofLog() << "Loop cache: " << capacity << " frames at " << width << "x" << height
+            << " (1/" << scale << " of " << sourceWidth << "x" << sourceHeight << ", " << fps << " fps), "
+            << getMemoryUsed() / (1024 * 1024) << " MB of " << memoryBudget / (1024 * 1024) << " MB";
+}
+
+void LoopFrameCache::record(const ofPixels &frame, float time, float _fps) {
+    if (playing || !frame.isAllocated() || !isRecordable(frame)) return;
+
+    if ((int)frame.getWidth() != sourceWidth || (int)frame.getHeight() != sourceHeight ||
+        frame.getPixelFormat() != format || _fps != fps || frames.empty()) {
+        allocate(frame.getWidth(), frame.getHeight(), frame.getPixelFormat(), frame.getNumChannels(), _fps);
+    }
+
+    // The window has to be one continuous stretch of the clip
+    if (count > 0) {
+        float last = frameAt(count - 1).time;
+        if (time == last) return;
+        if (time < last || time - last > 1.0f) {
+            first = 0;
+            count = 0;
+        }
+    }
+
+    ALLOCATION_FREE_SCOPE("loop cache record"); // the ring is only allocated per clip format
+    Frame *slot;
+    if (count < (int)frames.size()) {
+        slot = &frameAt(count);
+        count++;
+    } else {
+        // Full, the oldest frame goes
+        slot = &frames[first];
+        first = (first + 1) % frames.size();
+    }
+    slot->time = time;
+
+    if (scale == 1) {
+        memcpy(slot->pixels.getData(), frame.getData(), slot->pixels.getTotalBytes());
+        return;
+    }
+
+    // Box filter by the whole scale factor, rows split over the pool
+    const unsigned char *source = frame.getData();
+    unsigned char *target = slot->pixels.getData();
+    int sourceStride = sourceWidth * channels;
+    int area = scale * scale;
+    TilePool::get().forEachTile(height, 16, [&](int rowStart, int rowEnd, int) {
+        for (int y = rowStart; y < rowEnd; y++) {
+            unsigned char *out = target + (size_t)y * width * channels;
+            const unsigned char *in = source + (size_t)y * scale * sourceStride;
+            for (int x = 0; x < width; x++) {
+                for (int c = 0; c < channels; c++) {
+                    int sum = 0;
+                    for (int sy = 0; sy < scale; sy++) {
+                        const unsigned char *row = in + sy * sourceStride + x * scale * channels + c;
+                        for (int sx = 0; sx < scale; sx++) {
+                            sum += row[sx * channels];
+                        }
+                    }
+                    out[x * channels + c] = (unsigned char)((sum + area / 2) / area);
+                }
+            }
+        }
+    });
+}
+
+bool LoopFrameCache::startPlayback() {
+    if (count < minFrames) return false;
+    playing = true;
+    playhead = 0.0f;
+    upload(0);
+    return true;
+}
+
+void LoopFrameCache::stopPlayback() {
+    playing = false;
+    frameNew = false;
+    current = -1;
+}
+
+void LoopFrameCache::update(float deltaTime) {
+    frameNew = false;
+    if (!playing) return;
+
+    // Wraps after the last frame has had its full length
+    float length = getSpan() + frameLength(count - 1);
+    playhead = std::fmod(playhead + std::max(deltaTime, 0.0f), length);
+
+    // Last frame that starts at or before the playhead
+    float time = frameAt(0).time + playhead;
+    int low = 0;
+    int high = count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (frameAt(middle).time <= time) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    if (low != current) {
+        upload(low);
+    }
+}
+
+void LoopFrameCache::upload(int index) {
+    texture.loadData(frameAt(index).pixels);
+    FrameProfiler::get().countFrameCopy();
+    current = index;
+    frameNew = true;
+}
+
+float LoopFrameCache::frameLength(int index) const {
+    if (index + 1 < count) return frameAt(index + 1).time - frameAt(index).time;
+    // The last frame lasts as long as the clip's frame rate says
+    return fps > 0.0f ? 1.0f / fps : getSpan() / std::max(count - 1, 1);
+}
+
+float LoopFrameCache::getSpan() const {
+    return count > 1 ? frameAt(count - 1).time - frameAt(0).time : 0.0f;
+}
+
+size_t LoopFrameCache::getMemoryUsed() const {
+    return frames.size() * (size_t)width * height * channels;
+}
+
+std::string LoopFrameCache::describe() const {
+    std::stringstream description;
+    description << count << " frames (" << getSpan() << "s) at " << width << "x" << height
+                << " (1/" << scale << "), " << getMemoryUsed() / (1024 * 1024) << " of "
+                << memoryBudget / (1024 * 1024) << " MB";
+    return description.str();
+}
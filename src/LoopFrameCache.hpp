@@ -0,0 +1,81 @@
+//
+//  LoopFrameCache.hpp
+//  visual-soundfx-test2
+//
+//  Rolling window of the last few seconds of decoded footage, kept in RAM so a manual loop
+//  can play back from memory instead of seeking the decoder. Frames are recorded as they're
+//  decoded; when a loop starts the window is frozen and played back on its own clock, each
+//  frame held for as long as it was in the clip, then wraps with no seek and no overshoot.
+//
+//  The window is sized up front from the loop length and the clip's frame rate. When that
+//  doesn't fit the memory budget the frames are box-filtered down by a whole factor until
+//  it does. Main thread only.
+//
+
+#pragma once
+
+#include "ofMain.h"
+
+class LoopFrameCache {
+public:
+    // Upper bound for the recorded frames (also read from "loop_cache_mb" in footage.json)
+    void setMemoryBudget(size_t bytes);
+    size_t getMemoryBudget() const { return memoryBudget; }
+    void setLoopDuration(float seconds);
+
+    // Forget what's recorded - clip change, or the clip jumping (native loop wrap, seek)
+    void clear();
+    // Adds a decoded frame at time (seconds into the clip). fps sizes the window, it's
+    // reallocated when the frame size, format or fps change
+    void record(const ofPixels &frame, float time, float fps);
+
+    // Freezes the recorded window and plays it from the start, false if there's nothing to play
+    bool startPlayback();
+    void stopPlayback();
+    bool isPlaying() const { return playing; }
+    // Advances the playback clock, uploads the frame when it changes
+    void update(float deltaTime);
+    bool isFrameNew() const { return frameNew; }
+    const ofTexture &getTexture() const { return texture; }
+
+    int getFrameCount() const { return count; }
+    float getSpan() const;              // seconds covered by the recorded frames
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getScale() const { return scale; }  // 1 = full size, 2 = half, ...
+    size_t getMemoryUsed() const;       // bytes allocated for frames
+    std::string describe() const;
+
+private:
+    struct Frame {
+        ofPixels pixels;
+        float time = 0.0f;
+    };
+
+    void allocate(int sourceWidth, int sourceHeight, ofPixelFormat format, int channels, float fps);
+    Frame &frameAt(int index) { return frames[(first + index) % frames.size()]; }
+    const Frame &frameAt(int index) const { return frames[(first + index) % frames.size()]; }
+    float frameLength(int index) const;
+    void upload(int index);
+
+    size_t memoryBudget = 512 * 1024 * 1024;
+    float loopDuration = 6.0f;
+
+    std::vector<Frame> frames;  // ring, allocated once per clip format
+    int first = 0;
+    int count = 0;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    ofPixelFormat format = OF_PIXELS_RGB;   // the decoder's, kept as is
+    int channels = 0;
+    float fps = 0.0f;
+    int width = 0;
+    int height = 0;
+    int scale = 1;
+
+    bool playing = false;
+    bool frameNew = false;
+    float playhead = 0.0f;      // seconds since the first frame
+    int current = -1;
+    ofTexture texture;
+};
@@ -0,0 +1,111 @@
+//
+//  MidiReplay.cpp
+//  visual-soundfx-test2
+//
+
+#include "MidiReplay.hpp"
+
+MidiEvent MidiEvent::fromMessage(const ofxMidiMessage &message, uint64_t timeMicros) {
+    MidiEvent event;
+    event.status = message.status;
+    event.channel = message.channel;
+    event.pitch = message.pitch;
+    event.velocity = message.velocity;
+    event.control = message.control;
+    event.value = message.value;
+    event.timeMicros = timeMicros;
+    return event;
+}
+
+void MidiReplay::startRecording() {
+    recorded.clear();
+    recording = true;
+}
+
+void MidiReplay::record(const MidiEvent &event) {
+    if (recording) {
+        recorded.push_back(event);
+    }
+}
+
+bool MidiReplay::stopRecording(const std::string &path) {
+    recording = false;
+    if (recorded.empty()) {
+        ofLogWarning("MidiReplay") << "Nothing recorded";
+        return false;
+    }
+
+    // Times are saved relative to the first event
+    uint64_t firstMicros = recorded.front().timeMicros;
+    ofBuffer buffer;
+    for (const auto &event : recorded) {
+        buffer.append(ofToString((event.timeMicros - firstMicros) / 1000.0, 3) + " " +
+                      ofToString(event.status) + " " + ofToString(event.channel) + " " +
+                      ofToString(event.pitch) + " " + ofToString(event.velocity) + " " +
+                      ofToString(event.control) + " " + ofToString(event.value) + "\n");
+    }
+
+    bool saved = ofBufferToFile(path, buffer);
+    ofLog() << "Saved " << recorded.size() << " MIDI events to " << path;
+    return saved;
+}
+
+bool MidiReplay::isRecording() const {
+    return recording;
+}
+
+bool MidiReplay::load(const std::string &path) {
+    ofFile file(path);
+    if (!file.exists()) {
+        ofLogError("MidiReplay") << "Can't find " << path;
+        return false;
+    }
+
+    events.clear();
+    ofBuffer buffer = ofBufferFromFile(path);
+    for (const auto &line : buffer.getLines()) {
+        std::vector<std::string> parts = ofSplitString(line, " ", true, true);
+        if (parts.size() < 7 || parts[0][0] == '#') continue;
+
+        MidiEvent event;
+        event.timeMicros = (uint64_t)std::llround(ofToDouble(parts[0]) * 1000.0);
+        event.status = ofToInt(parts[1]);
+        event.channel = ofToInt(parts[2]);
+        event.pitch = ofToInt(parts[3]);
+        event.velocity = ofToInt(parts[4]);
+        event.control = ofToInt(parts[5]);
+        event.value = ofToInt(parts[6]);
+        events.push_back(event);
+    }
+
+    ofLog() << "Loaded " << events.size() << " MIDI events from " << path;
+    return !events.empty();
+}
+
+void MidiReplay::start(uint64_t nowMicros) {
+    nextEvent = 0;
+    startMicros = nowMicros;
+    playing = !events.empty();
+}
+
+void MidiReplay::stop() {
+    playing = false;
+}
+
+bool MidiReplay::isPlaying() const {
+    return playing;
+}
+
+bool MidiReplay::next(uint64_t nowMicros, MidiEvent &event) {
+    if (!playing) return false;
+    if (nextEvent >= events.size()) {
+        playing = false;
+        ofLog() << "MIDI replay finished";
+        return false;
+    }
+    if (startMicros + events[nextEvent].timeMicros > nowMicros) return false;
+
+    event = events[nextEvent++];
+    event.timeMicros += startMicros;
+    return true;
+}
@@ -0,0 +1,52 @@
+//
+//  MidiReplay.hpp
+//  visual-soundfx-test2
+//
+//  MidiEvent is what the ofxMidi callback thread hands to the main loop: a plain copy of the
+//  fields ChronologyManager uses plus the time it arrived. MidiReplay records those events to
+//  a text file and plays them back later at their original spacing, so the controller logic
+//  can be exercised without the hardware plugged in.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxMidi.h"
+
+struct MidiEvent {
+    int status;
+    int channel;
+    int pitch;
+    int velocity;
+    int control;
+    int value;
+    uint64_t timeMicros;  // ofGetElapsedTimeMicros() when it arrived
+
+    static MidiEvent fromMessage(const ofxMidiMessage &message, uint64_t timeMicros);
+};
+
+class MidiReplay {
+public:
+    // Recording (main thread, events as they are consumed)
+    void startRecording();
+    void record(const MidiEvent &event);
+    bool stopRecording(const std::string &path);
+    bool isRecording() const;
+
+    // One event per line: "time_ms status channel pitch velocity control value"
+    bool load(const std::string &path);
+    void start(uint64_t nowMicros);
+    void stop();
+    bool isPlaying() const;
+    // Next event that is due by nowMicros, with its time moved onto the current clock
+    bool next(uint64_t nowMicros, MidiEvent &event);
+
+private:
+    std::vector<MidiEvent> recorded;
+    bool recording = false;
+
+    std::vector<MidiEvent> events;
+    size_t nextEvent = 0;
+    uint64_t startMicros = 0;
+    bool playing = false;
+};
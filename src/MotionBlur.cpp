@@ -1,17 +1,107 @@
 #include "MotionBlur.hpp"
+#include "FrameProfiler.hpp"
+#include "AllocationCounter.hpp"
 #include <cmath>  // For sqrt and pow functions - which is used to calcultae euclidean distance between colours
 
 MotionBlur::MotionBlur(){
     blendFactor = 0.9f;  // determines how much of the current frame blends into the accumulation buffer
     stretchAmount = 0.2f;  // threshold to decide when to apply stretching effects based on motion intensity.
+    downsampleFactor = 4;  // size of the blocks compared between frames
+    hasPreviousFrame = false;
+    mode = MODE_CPU;
+    shaderReady = false;
+    gpuFrameIndex = 0;
 }
 
 void MotionBlur::setup(float _blendFactor, float _stretchAmount){
     blendFactor = _blendFactor;
     stretchAmount = _stretchAmount;
     
+    // Window sized until allocate() says otherwise
+    allocate(ofGetWidth(), ofGetHeight());
+
+    ofLog() << "MotionBlur: frame difference kernel using " << MotionBlurKernel::getInstructionSet();
+    setupShader();
+}
+
+void MotionBlur::setupShader() {
+    // MotionBlurKernel as a gather: the kernel writes each block's sample to up to two stretched
+    // positions in raster order, so a pixel ends up with the last block in its block row whose
+    // copy covers it. The offsets are whole pixels up to maxOffset, which keeps the search to a
+    // few blocks either side.
+    std::string fragment = R"(
+        #version 120
+        #extension GL_ARB_texture_rectangle : enable
+        uniform sampler2DRect current;
+        uniform sampler2DRect previous;
+        uniform float blockSize;
+        uniform float stretchAmount;
+        uniform float frameWidth;
+        uniform float maxOffset;
+        
+        vec4 sampleBytes(sampler2DRect frame, float x, float y) {
+            return floor(texture2DRect(frame, vec2(x + 0.5, y + 0.5)) * 255.0 + 0.5);
+        }
+        
+        void main() {
+            vec2 pos = floor(gl_TexCoord[0].st);
+            float rowY = floor(pos.y / blockSize) * blockSize;
+            float lastBlock = min(floor((pos.x + maxOffset) / blockSize), floor((frameWidth - 1.0) / blockSize));
+            float firstBlock = max(floor((pos.x - maxOffset - blockSize + 1.0) / blockSize), 0.0);
+            
+            vec4 color = vec4(0.0); // nothing written here stays transparent, like the kernel's clear
+            for (int i = 0; i < 64; i++) {
+                float sx = (lastBlock - float(i)) * blockSize;
+                if (sx < firstBlock * blockSize) break;
+                
+                vec4 cur = sampleBytes(current, sx, rowY);
+                vec4 prev = sampleBytes(previous, sx, rowY);
+                vec3 diff = cur.rgb - prev.rgb;
+                float stretch = sqrt(dot(diff, diff)) / 255.0 * stretchAmount;
+                
+                if (stretch > 0.0) {
+                    float offset = floor(stretch);
+                    float leftX = max(sx - offset, 0.0);
+                    float rightX = min(sx + offset, frameWidth - 1.0);
+                    if ((pos.x >= leftX && pos.x < leftX + blockSize) || (pos.x >= rightX && pos.x < rightX + blockSize)) {
+                        color = floor((cur + prev) * 0.5) / 255.0;
+                        break;
+                    }
+                } else if (pos.x >= sx && pos.x < sx + blockSize) {
+                    color = cur / 255.0;
+                    break;
+                }
+            }
+            gl_FragColor = color * gl_Color;
+        }
+    )";
+    
+    shaderReady = ofGetUsingArbTex() &&
+        distortShader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragment) && distortShader.linkProgram();
+    if (!shaderReady) {
+        ofLogWarning() << "MotionBlur: distortion shader unavailable, GPU mode disabled";
+        mode = MODE_CPU;
+    }
+}
+
+void MotionBlur::setMode(Mode _mode) {
+    if (_mode == MODE_GPU && !shaderReady) {
+        ofLogWarning() << "MotionBlur: no shader, staying on the CPU";
+        return;
+    }
+    if (_mode == mode) return;
+    
+    // The previous frame lives in different places for the two paths
+    mode = _mode;
+    hasPreviousFrame = false;
+    ofLog() << "MotionBlur: " << (mode == MODE_GPU ? "GPU shader" : "CPU kernel");
+}
+
+void MotionBlur::allocate(int width, int height) {
+    if (accumulationBuffer.isAllocated() && accumulationBuffer.getWidth() == width && accumulationBuffer.getHeight() == height) return;
+    
     // Allocate an accumulation buffer
-    accumulationBuffer.allocate(ofGetWidth(), ofGetHeight(), GL_RGBA);
+    accumulationBuffer.allocate(width, height, GL_RGBA);
     accumulationBuffer.begin();
     ofClear(0, 0, 0, 0); // Clear the buffer
     accumulationBuffer.end();
@@ -29,100 +119,194 @@ float MotionBlur::colorDistance(const ofColor &color1, const ofColor &color2) {
 }
 
 void MotionBlur::update(const ofTexture &videoTexture) {
+    PROFILE_SCOPE("motionblur update");
     
     // Skip processing if texture isn't ready
      if (!videoTexture.isAllocated()) return;
     
-    int downsampleFactor = 4;
-
-    // Converts texture to pixels
-    ofPixels currentPixels;
-    ofImage tempImage;
-    tempImage.allocate(videoTexture.getWidth(), videoTexture.getHeight(), OF_IMAGE_COLOR_ALPHA);
-    videoTexture.readToPixels(tempImage.getPixels());
-    currentPixels = tempImage.getPixels();
+    if (mode == MODE_GPU) {
+        processFrameGpu(videoTexture);
+        return;
+    }
 
-    // Allocates distorted frame buffer
-    if (!distortedFrame.isAllocated()) {
-        distortedFrame.allocate(ofGetWidth(), ofGetHeight(), GL_RGBA);
+    // Reads the texture straight into the reusable buffer (no reallocation once the size is known)
+    videoTexture.readToPixels(currentFramePixels);
+    if (currentFramePixels.getNumChannels() != 4) {
+        currentFramePixels.setImageType(OF_IMAGE_COLOR_ALPHA); // kernel works on RGBA only
     }
-    distortedFrame.begin();
-    ofClear(0, 0, 0, 0);
+
+    processFrame(currentFramePixels);
+
+    // Keeps the current frame as previous for next update - swapping avoids copying the pixels
+    previousFramePixels.swap(currentFramePixels);
+    hasPreviousFrame = true;
+}
+
+void MotionBlur::update(const ofPixels &framePixels) {
+    PROFILE_SCOPE("motionblur update");
+    // Skip processing until the readback has produced a frame
+    if (!framePixels.isAllocated() || framePixels.getNumChannels() != 4) return;
     
-    // If there's a previous frame to compare
+    if (mode == MODE_GPU) {
+        // Offline render and benchmark hand over pixels, so the GPU path uploads them itself
+        uploadedFrame.loadData(framePixels);
+        processFrameGpu(uploadedFrame);
+        return;
+    }
 
-    if (previousFramePixels.getWidth() != 0) {
-        int width = currentPixels.getWidth();
-        int height = currentPixels.getHeight();
-        
-        // Loop through the pixels with a step size of downsampleFactor for efficiency
-        for (int y = 0; y < height; y += downsampleFactor) {
-            for (int x = 0; x < width; x += downsampleFactor) {
-                // Get colours from the current and previous frame at the same pixel
-                ofColor currentColor = currentPixels.getColor(x, y);
-                ofColor previousColor = previousFramePixels.getColor(x, y);
-                
-                // Calculates how different the current pixel is from the previous
-                float difference = colorDistance(currentColor, previousColor);
-                
-                // Maps the color difference to a stretch amount (larger difference = more blur/stretch)
-                float stretch = ofMap(difference, 0, 255, 0, stretchAmount);
-
-                // If the pixels have moved / changed enough stretch them
-                if (stretch > 0) {
-                    int stretchOffset = stretch;
-                    // Calculate left and right stretch positions - clamped to image bounds
-                    int leftX = ofClamp(x - stretchOffset, 0, width - 1);
-                    int rightX = ofClamp(x + stretchOffset, 0, width - 1);
-
-                    // Blend the current and previous colors for a smooth visual transition
-                    ofColor blendColor = currentColor.getLerped(previousColor, 0.5f);
-                    ofSetColor(blendColor);
-
-                    // Draws rectangles at left and right positions to simulate motion blur
-                    ofDrawRectangle(leftX, y, downsampleFactor, downsampleFactor);
-                    ofDrawRectangle(rightX, y, downsampleFactor, downsampleFactor);
-                } else {
-                    // If there's no difference draw current pixel normally
-                    ofSetColor(currentColor);
-                    ofDrawRectangle(x, y, downsampleFactor, downsampleFactor);
-                }
-            }
+    processFrame(framePixels);
+
+    // The readback owns framePixels so keep our own copy, sized first so the copy never allocates
+    previousFramePixels.allocate(framePixels.getWidth(), framePixels.getHeight(), framePixels.getPixelFormat());
+    ALLOCATION_FREE_SCOPE("motionblur copy");
+    previousFramePixels = framePixels;
+    hasPreviousFrame = true;
+}
+
+void MotionBlur::processFrame(const ofPixels &framePixels) {
+    int width = framePixels.getWidth();
+    int height = framePixels.getHeight();
+    distortedPixels.allocate(width, height, OF_PIXELS_RGBA); // no-op unless the size changed
+    {
+        ALLOCATION_FREE_SCOPE("motionblur kernel");
+
+        // If there's a previous frame to compare
+        if (hasPreviousFrame && previousFramePixels.getWidth() == width && previousFramePixels.getHeight() == height) {
+            // Difference / stretch / blend for every block, written directly into distortedPixels
+            MotionBlurKernel::process(framePixels.getData(), previousFramePixels.getData(),
+                                      distortedPixels.getData(), width, height, downsampleFactor, stretchAmount);
+        } else {
+            distortedPixels.set(0); // nothing to compare yet - stays transparent
         }
     }
 
-    // Finish drawing to the framebuffer
-    distortedFrame.end();
+    // Single upload instead of thousands of rectangle draws
+    if (!distortedFrame.isAllocated() || distortedFrame.getWidth() != width || distortedFrame.getHeight() != height) {
+        distortedFrame.allocate(distortedPixels);
+    }
+    distortedFrame.loadData(distortedPixels);
 
     // Accumulate
     accumulationBuffer.begin();
     ofSetColor(255, 255, 255, blendFactor * 255);
-    distortedFrame.draw(0, 0, ofGetWidth(), ofGetHeight());
+    distortedFrame.draw(0, 0, accumulationBuffer.getWidth(), accumulationBuffer.getHeight());
     accumulationBuffer.end();
+    FrameProfiler::get().countFrameCopy();
+}
 
-    // Stores the current frame pixels as previous for next update
-    previousFramePixels = currentPixels;
+void MotionBlur::processFrameGpu(const ofTexture &frame) {
+    PROFILE_GPU_SCOPE("motionblur shader");
+    int width = frame.getWidth();
+    int height = frame.getHeight();
+    if (!gpuFrames[0].isAllocated() || gpuFrames[0].getWidth() != width || gpuFrames[0].getHeight() != height) {
+        for (ofFbo &gpuFrame : gpuFrames) {
+            gpuFrame.allocate(width, height, GL_RGBA);
+        }
+        hasPreviousFrame = false;
+    }
+    
+    // Our own copy of the frame - the source texture may be reused by the next one
+    ofFbo &current = gpuFrames[gpuFrameIndex];
+    ofFbo &previous = gpuFrames[1 - gpuFrameIndex];
+    current.begin();
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    ofSetColor(255);
+    frame.draw(0, 0, width, height);
+    ofPopStyle();
+    current.end();
+    FrameProfiler::get().countFrameCopy();
+    
+    // Nothing to compare on the first frame, the CPU path draws a transparent frame there
+    if (hasPreviousFrame) {
+        accumulationBuffer.begin();
+        ofSetColor(255, 255, 255, blendFactor * 255);
+        drawDistorted(current.getTexture(), previous.getTexture(), accumulationBuffer.getWidth(), accumulationBuffer.getHeight());
+        accumulationBuffer.end();
+        FrameProfiler::get().countFrameCopy();
+    }
+    
+    gpuFrameIndex = 1 - gpuFrameIndex;
+    hasPreviousFrame = true;
 }
 
+void MotionBlur::drawDistorted(const ofTexture &current, const ofTexture &previous, float width, float height) {
+    // Largest whole-pixel offset any block can get: the RGB distance tops out at sqrt(3) * 255
+    float maxOffset = floor(sqrt(3.0f) * stretchAmount);
+    
+    distortShader.begin();
+    distortShader.setUniformTexture("previous", previous, 1);
+    distortShader.setUniform1f("blockSize", downsampleFactor);
+    distortShader.setUniform1f("stretchAmount", stretchAmount);
+    distortShader.setUniform1f("frameWidth", current.getWidth());
+    distortShader.setUniform1f("maxOffset", maxOffset);
+    current.draw(0, 0, width, height); // binds the current frame as "current" on unit 0
+    distortShader.end();
+}
 
-void MotionBlur::apply(ofFbo& fbo) {
-    // Create temporary FBO
-    ofFbo tempFbo;
-    tempFbo.allocate(fbo.getWidth(), fbo.getHeight());
+MotionBlur::ParityResult MotionBlur::checkParity(const ofPixels &current, const ofPixels &previous, int tolerance, float maxMismatched) {
+    ParityResult result;
+    result.width = current.getWidth();
+    result.height = current.getHeight();
+    if (!shaderReady || current.getNumChannels() != 4 || previous.getNumChannels() != 4 ||
+        previous.getWidth() != current.getWidth() || previous.getHeight() != current.getHeight()) {
+        ofLogError() << "MotionBlur: parity check needs the shader and two RGBA frames of the same size";
+        return result;
+    }
     
-    // Apply motion blur to the input FBO
-    tempFbo.begin();
-    ofClear(0, 0, 0, 255);
-    accumulationBuffer.draw(0, 0);
-    tempFbo.end();
+    ofPixels cpuPixels;
+    cpuPixels.allocate(result.width, result.height, OF_PIXELS_RGBA);
+    MotionBlurKernel::process(current.getData(), previous.getData(), cpuPixels.getData(),
+                              result.width, result.height, downsampleFactor, stretchAmount);
+    
+    // Same size and no blending, so the target holds exactly what the shader wrote
+    ofTexture currentTexture, previousTexture;
+    currentTexture.loadData(current);
+    previousTexture.loadData(previous);
+    ofFbo target;
+    target.allocate(result.width, result.height, GL_RGBA);
+    target.begin();
+    ofClear(0, 0, 0, 0);
+    ofPushStyle();
+    ofDisableAlphaBlending();
+    ofSetColor(255);
+    drawDistorted(currentTexture, previousTexture, result.width, result.height);
+    ofPopStyle();
+    target.end();
     
-    // Draw result back to original FBO
+    ofPixels gpuPixels;
+    target.readToPixels(gpuPixels);
+    
+    size_t mismatched = 0;
+    size_t pixelCount = (size_t)result.width * result.height;
+    const unsigned char *cpu = cpuPixels.getData();
+    const unsigned char *gpu = gpuPixels.getData();
+    for (size_t i = 0; i < pixelCount; i++) {
+        int pixelDifference = 0;
+        for (int c = 0; c < 4; c++) {
+            pixelDifference = std::max(pixelDifference, std::abs(cpu[i * 4 + c] - gpu[i * 4 + c]));
+        }
+        result.maxDifference = std::max(result.maxDifference, pixelDifference);
+        if (pixelDifference > tolerance) mismatched++;
+    }
+    result.mismatchedFraction = pixelCount > 0 ? (float)mismatched / pixelCount : 0.0f;
+    result.passed = result.mismatchedFraction <= maxMismatched;
+    return result;
+}
+
+void MotionBlur::apply(ofFbo& fbo) {
+    // Straight into the target - the old temporary FBO held exactly this and was copied over
     fbo.begin();
     ofClear(0, 0, 0, 255);
-    tempFbo.draw(0, 0);
+    accumulationBuffer.draw(0, 0, fbo.getWidth(), fbo.getHeight());
     fbo.end();
 }
 
+void MotionBlur::draw(float x, float y, float width, float height) {
+    PROFILE_SCOPE("motionblur draw");
+    accumulationBuffer.draw(x, y, width, height);
+}
+
 void MotionBlur::clear(){
     // Clear the accumulation buffer
     accumulationBuffer.begin();
@@ -150,6 +334,24 @@ float MotionBlur::getStretchAmount() const {
     return stretchAmount;
 }
 
+void MotionBlur::addOscRoutes(OscRouter &router) {
+    // Map room size value to blend factor range and wet level to stretch amount range
+    router.addFloat("/reverb/roomSize", [this](float value) {
+        setBlendFactor(ofMap(value, 0.0f, 1.0f, 0.1f, 2.0f));
+    });
+    router.addFloat("/reverb/wetLevel", [this](float value) {
+        setStretchAmount(ofMap(value, 0.0f, 1.0f, 0.1f, 1.5f));
+    });
+    
+    // Map delay time to blend factor and feedback to stretch
+    router.addFloat("/delay/delayTime", [this](float value) {
+        setBlendFactor(ofMap(value, 0.0f, 2000.0f, 0.1f, 3.0f));
+    });
+    router.addFloat("/delay/feedback", [this](float value) {
+        setStretchAmount(ofMap(value, 0.0f, 1.0f, 0.1f, 2.0f));
+    });
+}
+
 void MotionBlur::resetAllParameters() {
     blendFactor = 0.0f;
     stretchAmount = 0.0f;
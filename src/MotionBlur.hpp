@@ -9,13 +9,41 @@
 
 #include "ofMain.h"
 #include "ofVideoPlayer.h"
+#include "MotionBlurKernel.hpp"
+#include "OscRouter.hpp"
 
 class MotionBlur {
 public:
     MotionBlur();  // Constructor to initialize the effect
     
+    // Same difference/stretch/blend either way: the CPU kernel on read-back pixels, or a
+    // fragment shader over the current and previous frame textures
+    enum Mode {
+        MODE_CPU,
+        MODE_GPU
+    };
+    
     void setup(float _blendFactor, float _stretchAmount);
+    // Size the blur accumulates at (the window's after setup), frames of any size are scaled to it
+    void allocate(int width, int height);
     void update(const ofTexture &videoTexture);
+    void update(const ofPixels &framePixels); // pixels from the shared FrameReadback
+    
+    void setMode(Mode _mode);   // stays on the CPU if the shader didn't compile
+    Mode getMode() const { return mode; }
+    bool usesPixels() const { return mode == MODE_CPU; }
+    
+    // Distorts one frame pair both ways and compares the results (needs the GL context). The
+    // shader's sqrt can land either side of a whole-pixel offset where the CPU's doesn't, which
+    // moves a whole block, so a few pixels may differ a lot - judged by how many differ.
+    struct ParityResult {
+        int width = 0;
+        int height = 0;
+        int maxDifference = 0;          // largest channel difference anywhere
+        float mismatchedFraction = 0.0f; // pixels with a channel off by more than the tolerance
+        bool passed = false;
+    };
+    ParityResult checkParity(const ofPixels &current, const ofPixels &previous, int tolerance = 1, float maxMismatched = 0.001f);
    // void apply(ofVideoPlayer &video, float x, float y, float width, float height);
     float colorDistance(const ofColor &color1, const ofColor &color2);
     void clear();
@@ -29,10 +57,31 @@ public:
     float getStretchAmount() const;
     void resetAllParameters();
     void apply(ofFbo& fbo);
+    void draw(float x, float y, float width, float height); // the blurred result into the current target
+    
+    // Reverb and delay parameters from the audio host both drive the blur
+    void addOscRoutes(OscRouter &router);
 private:
+    void setupShader();
+    void processFrame(const ofPixels &framePixels);
+    void processFrameGpu(const ofTexture &frame);
+    // Distorted frame drawn at width x height into the current target, tinted by the current colour
+    void drawDistorted(const ofTexture &current, const ofTexture &previous, float width, float height);
+
     float blendFactor;
     float stretchAmount;
-    ofPixels previousFramePixels;
+    int downsampleFactor;
+    bool hasPreviousFrame;
+    ofPixels currentFramePixels;   // reused every frame for the texture readback
+    ofPixels previousFramePixels;  // swapped with currentFramePixels instead of copied
+    ofPixels distortedPixels;      // kernel output, uploaded in one go
     ofFbo accumulationBuffer;
-    ofFbo distortedFrame;
+    ofTexture distortedFrame;
+    
+    Mode mode;
+    ofShader distortShader;
+    bool shaderReady;
+    ofFbo gpuFrames[2];     // current and previous frame, swapped instead of copied
+    int gpuFrameIndex;
+    ofTexture uploadedFrame; // pixels handed to the GPU path
 };
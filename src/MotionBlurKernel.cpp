@@ -0,0 +1,226 @@
+//
+//  MotionBlurKernel.cpp
+//  visual-soundfx-test2
+//
+
+#include "MotionBlurKernel.hpp"
+#include "TilePool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Pick the widest instruction set the compiler is targeting, scalar otherwise
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define MOTION_KERNEL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define MOTION_KERNEL_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define MOTION_KERNEL_NEON
+#endif
+
+namespace {
+
+const int samplesPerBatch = 8; // samples measured together before their blocks are written
+
+inline uint32_t loadPixel(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, 4);
+    return value;
+}
+
+// Per-byte floor((a + b) / 2) - matches ofColor::getLerped(other, 0.5f) which truncates
+inline uint32_t averagePixels(uint32_t a, uint32_t b) {
+    return ((a & 0xFEFEFEFEu) >> 1) + ((b & 0xFEFEFEFEu) >> 1) + (a & b & 0x01010101u);
+}
+
+// Writes one block, clipped to the image the same way the FBO clipped ofDrawRectangle
+inline void fillBlock(uint8_t* output, int width, int height, int x, int y, int blockSize, uint32_t color) {
+    int x1 = std::min(x + blockSize, width);
+    int y1 = std::min(y + blockSize, height);
+    for (int row = y; row < y1; row++) {
+        uint32_t* dst = reinterpret_cast<uint32_t*>(output + ((size_t)row * width + x) * 4);
+        std::fill(dst, dst + (x1 - x), color);
+    }
+}
+
+// Turns a colour distance into the stretch offset, -1 when the sample hasn't changed.
+// Kept in the same order as the old ofMap(difference, 0, 255, 0, stretchAmount).
+inline int stretchOffset(float difference, float stretchAmount) {
+    float stretch = difference / 255.0f * stretchAmount;
+    return stretch > 0 ? (int)stretch : -1;
+}
+
+inline void measureScalar(const uint32_t* cur, const uint32_t* prev, float stretchAmount, int* offsets) {
+    for (int i = 0; i < samplesPerBatch; i++) {
+        int d2 = 0;
+        for (int c = 0; c < 3; c++) { // RGB only, alpha is ignored like colorDistance()
+            int diff = (int)((cur[i] >> (c * 8)) & 0xFF) - (int)((prev[i] >> (c * 8)) & 0xFF);
+            d2 += diff * diff;
+        }
+        offsets[i] = stretchOffset(std::sqrt((float)d2), stretchAmount);
+    }
+}
+
+#if defined(MOTION_KERNEL_SSE2) || defined(MOTION_KERNEL_AVX2)
+// Squared RGB distance for 4 packed RGBA pixels
+inline __m128i squaredDistance4(__m128i cur, __m128i prev) {
+    const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i zero = _mm_setzero_si128();
+    cur = _mm_and_si128(cur, rgbMask);
+    prev = _mm_and_si128(prev, rgbMask);
+
+    __m128i diffLo = _mm_sub_epi16(_mm_unpacklo_epi8(cur, zero), _mm_unpacklo_epi8(prev, zero));
+    __m128i diffHi = _mm_sub_epi16(_mm_unpackhi_epi8(cur, zero), _mm_unpackhi_epi8(prev, zero));
+    // madd leaves (r*r + g*g) and (b*b + 0) per pixel, the shuffles pair them back up
+    __m128 sumLo = _mm_castsi128_ps(_mm_madd_epi16(diffLo, diffLo));
+    __m128 sumHi = _mm_castsi128_ps(_mm_madd_epi16(diffHi, diffHi));
+    __m128i rg = _mm_castps_si128(_mm_shuffle_ps(sumLo, sumHi, _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i b = _mm_castps_si128(_mm_shuffle_ps(sumLo, sumHi, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(rg, b);
+}
+
+inline __m128i stretchOffset4(__m128i d2, float stretchAmount) {
+    __m128 difference = _mm_sqrt_ps(_mm_cvtepi32_ps(d2));
+    __m128 stretch = _mm_mul_ps(_mm_div_ps(difference, _mm_set1_ps(255.0f)), _mm_set1_ps(stretchAmount));
+    __m128i changed = _mm_castps_si128(_mm_cmpgt_ps(stretch, _mm_setzero_ps()));
+    __m128i offset = _mm_cvttps_epi32(stretch);
+    return _mm_or_si128(_mm_and_si128(changed, offset), _mm_andnot_si128(changed, _mm_set1_epi32(-1)));
+}
+#endif
+
+inline void measureBatch(const uint32_t* cur, const uint32_t* prev, float stretchAmount, int* offsets) {
+#if defined(MOTION_KERNEL_AVX2)
+    const __m256i rgbMask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i c = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)cur), rgbMask);
+    __m256i p = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)prev), rgbMask);
+    __m256i diffLo = _mm256_sub_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(p, zero));
+    __m256i diffHi = _mm256_sub_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(p, zero));
+    __m256 sumLo = _mm256_castsi256_ps(_mm256_madd_epi16(diffLo, diffLo));
+    __m256 sumHi = _mm256_castsi256_ps(_mm256_madd_epi16(diffHi, diffHi));
+    // In-lane unpack + shuffle keeps the samples in order (0-3 low lane, 4-7 high lane)
+    __m256i d2 = _mm256_add_epi32(_mm256_castps_si256(_mm256_shuffle_ps(sumLo, sumHi, _MM_SHUFFLE(2, 0, 2, 0))),
+                                  _mm256_castps_si256(_mm256_shuffle_ps(sumLo, sumHi, _MM_SHUFFLE(3, 1, 3, 1))));
+
+    __m256 difference = _mm256_sqrt_ps(_mm256_cvtepi32_ps(d2));
+    __m256 stretch = _mm256_mul_ps(_mm256_div_ps(difference, _mm256_set1_ps(255.0f)), _mm256_set1_ps(stretchAmount));
+    __m256i changed = _mm256_castps_si256(_mm256_cmp_ps(stretch, _mm256_setzero_ps(), _CMP_GT_OQ));
+    __m256i offset = _mm256_blendv_epi8(_mm256_set1_epi32(-1), _mm256_cvttps_epi32(stretch), changed);
+    _mm256_storeu_si256((__m256i*)offsets, offset);
+#elif defined(MOTION_KERNEL_SSE2)
+    for (int i = 0; i < samplesPerBatch; i += 4) {
+        __m128i d2 = squaredDistance4(_mm_loadu_si128((const __m128i*)(cur + i)),
+                                      _mm_loadu_si128((const __m128i*)(prev + i)));
+        _mm_storeu_si128((__m128i*)(offsets + i), stretchOffset4(d2, stretchAmount));
+    }
+#elif defined(MOTION_KERNEL_NEON)
+    const uint32x4_t rgbMask = vdupq_n_u32(0x00FFFFFF);
+    for (int i = 0; i < samplesPerBatch; i += 4) {
+        uint8x16_t c = vreinterpretq_u8_u32(vandq_u32(vld1q_u32(cur + i), rgbMask));
+        uint8x16_t p = vreinterpretq_u8_u32(vandq_u32(vld1q_u32(prev + i), rgbMask));
+        int16x8_t diffLo = vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(c), vget_low_u8(p)));
+        int16x8_t diffHi = vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(c), vget_high_u8(p)));
+        // Square each channel then pairwise add down to one sum per pixel
+        int32x4_t sq0 = vmull_s16(vget_low_s16(diffLo), vget_low_s16(diffLo));
+        int32x4_t sq1 = vmull_s16(vget_high_s16(diffLo), vget_high_s16(diffLo));
+        int32x4_t sq2 = vmull_s16(vget_low_s16(diffHi), vget_low_s16(diffHi));
+        int32x4_t sq3 = vmull_s16(vget_high_s16(diffHi), vget_high_s16(diffHi));
+        int32x4_t d2 = vpaddq_s32(vpaddq_s32(sq0, sq1), vpaddq_s32(sq2, sq3));
+
+        float32x4_t difference = vsqrtq_f32(vcvtq_f32_s32(d2));
+        float32x4_t stretch = vmulq_n_f32(vdivq_f32(difference, vdupq_n_f32(255.0f)), stretchAmount);
+        uint32x4_t changed = vcgtq_f32(stretch, vdupq_n_f32(0.0f));
+        int32x4_t offset = vbslq_s32(changed, vcvtq_s32_f32(stretch), vdupq_n_s32(-1));
+        vst1q_s32(offsets + i, offset);
+    }
+#else
+    measureScalar(cur, prev, stretchAmount, offsets);
+#endif
+}
+
+// Rows [rowStart, rowEnd), rowStart on a block boundary. Blocks only ever move sideways, so
+// separate block rows never touch each other's pixels and can run on different threads.
+template <bool useSimd>
+void processRows(const uint8_t* current, const uint8_t* previous, uint8_t* output,
+                 int width, int blockSize, float stretchAmount, int rowStart, int rowEnd) {
+    // Start from a transparent frame, same as ofClear(0, 0, 0, 0) on the old FBO
+    std::memset(output + (size_t)rowStart * width * 4, 0, (size_t)width * (rowEnd - rowStart) * 4);
+
+    uint32_t cur[samplesPerBatch];
+    uint32_t prev[samplesPerBatch];
+    int offsets[samplesPerBatch];
+
+    for (int y = rowStart; y < rowEnd; y += blockSize) {
+        const uint8_t* rowCur = current + (size_t)y * width * 4;
+        const uint8_t* rowPrev = previous + (size_t)y * width * 4;
+
+        for (int x = 0; x < width; x += blockSize * samplesPerBatch) {
+            // Gather one sample per block - unused lanes are zero so they just measure as unchanged
+            int count = 0;
+            for (; count < samplesPerBatch && x + count * blockSize < width; count++) {
+                int sx = x + count * blockSize;
+                cur[count] = loadPixel(rowCur + sx * 4);
+                prev[count] = loadPixel(rowPrev + sx * 4);
+            }
+            for (int i = count; i < samplesPerBatch; i++) {
+                cur[i] = prev[i] = 0;
+            }
+
+            if (useSimd) {
+                measureBatch(cur, prev, stretchAmount, offsets);
+            } else {
+                measureScalar(cur, prev, stretchAmount, offsets);
+            }
+
+            for (int i = 0; i < count; i++) {
+                int sx = x + i * blockSize;
+                if (offsets[i] >= 0) {
+                    // Moved enough - write the blended colour either side of the sample
+                    int leftX = std::max(sx - offsets[i], 0);
+                    int rightX = std::min(sx + offsets[i], width - 1);
+                    uint32_t blendColor = averagePixels(cur[i], prev[i]);
+                    fillBlock(output, width, rowEnd, leftX, y, blockSize, blendColor);
+                    fillBlock(output, width, rowEnd, rightX, y, blockSize, blendColor);
+                } else {
+                    fillBlock(output, width, rowEnd, sx, y, blockSize, cur[i]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void MotionBlurKernel::process(const uint8_t* current, const uint8_t* previous, uint8_t* output,
+                               int width, int height, int blockSize, float stretchAmount) {
+    if (width <= 0 || height <= 0 || blockSize <= 0) return;
+
+    // Tiles of whole block rows across the pool, ~32 pixel rows each
+    int blockRows = (height + blockSize - 1) / blockSize;
+    int tileBlockRows = std::max(32 / blockSize, 1);
+    TilePool::get().forEachTile(blockRows, tileBlockRows, [&](int tileStart, int tileEnd, int) {
+        processRows<true>(current, previous, output, width, blockSize, stretchAmount,
+                          tileStart * blockSize, std::min(tileEnd * blockSize, height));
+    });
+}
+
+void MotionBlurKernel::processScalar(const uint8_t* current, const uint8_t* previous, uint8_t* output,
+                                     int width, int height, int blockSize, float stretchAmount) {
+    if (width <= 0 || height <= 0 || blockSize <= 0) return;
+    processRows<false>(current, previous, output, width, blockSize, stretchAmount, 0, height);
+}
+
+const char* MotionBlurKernel::getInstructionSet() {
+#if defined(MOTION_KERNEL_AVX2)
+    return "AVX2";
+#elif defined(MOTION_KERNEL_SSE2)
+    return "SSE2";
+#elif defined(MOTION_KERNEL_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
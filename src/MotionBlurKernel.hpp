@@ -0,0 +1,29 @@
+//
+//  MotionBlurKernel.hpp
+//  visual-soundfx-test2
+//
+//  CPU frame-difference kernel behind MotionBlur::update.
+//  Works on plain RGBA8 arrays so it can run without a GL context.
+//
+
+#pragma once
+
+#include <cstdint>
+
+class MotionBlurKernel {
+public:
+    // Compares current against previous in blockSize x blockSize steps and writes the
+    // stretched / blended blocks straight into output (all three are RGBA8, width * height).
+    // Output is cleared to transparent first, then blocks are written in raster order so
+    // later blocks overwrite earlier ones exactly like the old rectangle draws did.
+    // Block rows are split across the TilePool, the result doesn't depend on the thread count.
+    static void process(const uint8_t* current, const uint8_t* previous, uint8_t* output,
+                        int width, int height, int blockSize, float stretchAmount);
+
+    // Same result without any SIMD or threads, used as the fallback and as a reference
+    static void processScalar(const uint8_t* current, const uint8_t* previous, uint8_t* output,
+                              int width, int height, int blockSize, float stretchAmount);
+
+    // Name of the instruction set process() was compiled for (for logging)
+    static const char* getInstructionSet();
+};
@@ -0,0 +1,276 @@
+//
+//  OfflineRender.cpp
+//  visual-soundfx-test2
+//
+
+#include "OfflineRender.hpp"
+
+namespace {
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+bool OfflineRender::parseArguments(int argc, char *argv[], Settings &settings) {
+    bool render = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--render" && hasValue) {
+            settings.input = argv[++i];
+            render = true;
+        } else if (arg == "--out" && hasValue) {
+            settings.outputDir = argv[++i];
+        } else if (arg == "--effects" && hasValue) {
+            settings.effects = ofSplitString(argv[++i], ",", true, true);
+        } else if (arg == "--seed" && hasValue) {
+            settings.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--frames" && hasValue) {
+            settings.maxFrames = ofToInt(argv[++i]);
+        } else if (arg == "--fps" && hasValue) {
+            settings.fps = std::max(ofToFloat(argv[++i]), 1.0f);
+        } else if (arg == "--format" && hasValue) {
+            settings.format = ofToLower(argv[++i]);
+        } else if (arg == "--size" && hasValue) {
+            std::vector<std::string> size = ofSplitString(argv[++i], "x");
+            if (size.size() == 2 && ofToInt(size[0]) > 0 && ofToInt(size[1]) > 0) {
+                settings.width = ofToInt(size[0]);
+                settings.height = ofToInt(size[1]);
+            } else {
+                ofLogWarning("OfflineRender") << "Ignoring --size " << argv[i] << ", expected WxH";
+            }
+        } else if (ofIsStringInString(arg, "--")) {
+            // (single dash ones come from Xcode/the OS, leave those alone)
+            ofLogWarning("OfflineRender") << "Unknown argument " << arg;
+        }
+    }
+    return render;
+}
+
+void OfflineRender::setup() {
+    // As fast as the frames can be made, with every frame one fixed time step later
+    ofSetFrameRate(0);
+    ofSetVerticalSync(false);
+    ofSetTimeModeFixedRate(ofGetFixedStepForFps(settings.fps));
+    ofSeedRandom((int)settings.seed);
+
+    // Same starting parameters as the live app
+    motionBlur.setup(1.0f, 0.6f);
+    stepPrinting.setup(30);
+    fisheye.setup(1.5f);
+    glitchEffect.setup();
+    glitchEffect.setSeed(settings.seed);
+
+    effectChain.allocate(settings.width, settings.height);
+    effectChain.addStage(std::make_unique<MotionBlurStage>(motionBlur));
+    effectChain.addStage(std::make_unique<GlitchStage>(glitchEffect));
+    effectChain.addStage(std::make_unique<StepPrintingStage>(stepPrinting));
+    effectChain.addStage(std::make_unique<FisheyeStage>(fisheye));
+
+    // The chain runs in the order given on the command line. motionblur and glitch draw over
+    // their input, so only one of them, and only first
+    for (int i = 0; i < (int)settings.effects.size(); i++) {
+        const std::string &name = settings.effects[i];
+        EffectStage *stage = effectChain.getStage(name);
+        if (stage && stage->replacesInput() && i > 0) {
+            ofLogError("OfflineRender") << name << " draws over its input, it has to be the first (and only such) effect";
+            finish(false);
+            return;
+        }
+        if (!effectChain.setEnabled(name, true)) {
+            finish(false);
+            return;
+        }
+        // Every other stage to the back in turn, which leaves them in the order given
+        effectChain.moveStage(name, stage->replacesInput() ? 0 : std::numeric_limits<int>::max());
+    }
+
+    if (!openSource()) {
+        finish(false);
+        return;
+    }
+
+    ofDirectory::createDirectory(settings.outputDir, true, true);
+    writer.setup();
+
+    ofLog() << "Offline render: " << settings.input << " (" << totalFrames << " frames) through " << effectChain.describe()
+            << " at " << settings.width << "x" << settings.height << ", seed " << settings.seed << " -> " << settings.outputDir;
+    startTime = std::chrono::steady_clock::now();
+}
+
+bool OfflineRender::openSource() {
+    ofDirectory directory(settings.input);
+    if (directory.isDirectory()) {
+        directory.allowExt("png");
+        directory.allowExt("jpg");
+        directory.allowExt("jpeg");
+        directory.allowExt("bmp");
+        directory.allowExt("tif");
+        directory.listDir();
+        directory.sort();
+        for (size_t i = 0; i < directory.size(); i++) {
+            imagePaths.push_back(directory.getPath(i));
+        }
+        totalFrames = imagePaths.size();
+        if (imagePaths.empty()) {
+            ofLogError("OfflineRender") << "No images in " << settings.input;
+            return false;
+        }
+        return true;
+    }
+
+    // Pixels only - the frames are uploaded to our own texture after resizing
+    video.setUseTexture(false);
+    if (!video.load(settings.input)) {
+        ofLogError("OfflineRender") << "Can't open " << settings.input;
+        return false;
+    }
+    video.setLoopState(OF_LOOP_NONE);
+    video.play();
+    video.setPaused(true);
+    totalFrames = video.getTotalNumFrames();
+    return true;
+}
+
+bool OfflineRender::readFrame(ofPixels &pixels) {
+    if (!imagePaths.empty()) {
+        if (framesRendered >= (int)imagePaths.size()) return false;
+        if (!ofLoadImage(pixels, imagePaths[framesRendered])) {
+            ofLogError("OfflineRender") << "Can't load " << imagePaths[framesRendered];
+            return false;
+        }
+    } else {
+        if (framesRendered >= totalFrames) return false;
+
+        // Step one frame and wait for the decoder - never skip or repeat frames
+        if (framesRendered > 0) video.nextFrame();
+        auto waitStart = std::chrono::steady_clock::now();
+        video.update();
+        while (!video.isFrameNew() && secondsSince(waitStart) < 2.0) {
+            ofSleepMillis(1);
+            video.update();
+        }
+        if (!video.isFrameNew() && (framesRendered > 0 || !video.getPixels().isAllocated())) {
+            ofLogWarning("OfflineRender") << "Decoder stopped at frame " << framesRendered;
+            return false;
+        }
+        pixels = video.getPixels();
+    }
+
+    // RGBA like the live readback - the motion blur kernel only takes 4 channels
+    pixels.setImageType(OF_IMAGE_COLOR_ALPHA);
+    if (pixels.getWidth() != settings.width || pixels.getHeight() != settings.height) {
+        pixels.resize(settings.width, settings.height);
+    }
+    return true;
+}
+
+bool OfflineRender::differsFromSource(const ofPixels &output) const {
+    if (output.getWidth() != sourcePixels.getWidth() || output.getHeight() != sourcePixels.getHeight()) return true;
+    const unsigned char *out = output.getData();
+    const unsigned char *source = sourcePixels.getData();
+    size_t pixelCount = output.getWidth() * output.getHeight();
+    int outChannels = output.getNumChannels();
+    int sourceChannels = sourcePixels.getNumChannels();
+    for (size_t i = 0; i < pixelCount; i++) {
+        for (int c = 0; c < 3; c++) {
+            if (out[i * outChannels + c] != source[i * sourceChannels + c]) return true;
+        }
+    }
+    return false;
+}
+
+void OfflineRender::update() {
+    if (finished) return;
+
+    if ((settings.maxFrames > 0 && framesRendered >= settings.maxFrames) || !readFrame(sourcePixels)) {
+        finish(framesRendered > 0);
+        return;
+    }
+
+    // Every frame is a new frame here, and the CPU effects get the decoded pixels directly
+    sourceTexture.loadData(sourcePixels);
+    effectChain.update(sourceTexture, &sourcePixels, true);
+    effectChain.render(sourceTexture).readToPixels(outputPixels);
+    outputPixels.setImageType(OF_IMAGE_COLOR);
+    if (!outputChanged && framesRendered > 0) {
+        outputChanged = differsFromSource(outputPixels);
+    }
+
+    // Don't let encoding fall too far behind
+    while (writer.getPending() > 8) {
+        ofSleepMillis(1);
+    }
+    writer.write(settings.outputDir + "/frame_" + ofToString(framesRendered, 5, '0') + "." + settings.format, outputPixels);
+    framesRendered++;
+
+    if (framesRendered % 100 == 0) {
+        ofLog() << "Rendered " << framesRendered << "/" << totalFrames << " frames, "
+                << ofToString(framesRendered / secondsSince(startTime), 1) << " fps";
+    }
+}
+
+void OfflineRender::draw() {
+    ofBackground(0);
+    ofDrawBitmapString("Rendering frame " + ofToString(framesRendered) + "/" + ofToString(totalFrames), 20, 20);
+}
+
+void OfflineRender::finish(bool success) {
+    if (finished) return;
+    finished = true;
+
+    writer.stop();
+    success = success && writer.getFailed() == 0;
+
+    // Motion blur only has something to show from the second frame on - a render where it
+    // never did means the frames didn't reach it (see readFrame)
+    if (success && framesRendered > 1 && effectChain.isEnabled("motionblur") && !outputChanged) {
+        ofLogError("OfflineRender") << "Every motionblur frame came out the same as its input";
+        success = false;
+    }
+
+    if (framesRendered > 0) {
+        double seconds = secondsSince(startTime);
+        ofLog() << "Offline render " << (success ? "done" : "failed") << ": " << framesRendered << " frames in "
+                << ofToString(seconds, 2) << " s (" << ofToString(framesRendered / seconds, 1) << " fps including encoding)";
+    }
+    ofExit(success ? 0 : 1);
+}
+
+void OfflineRender::exit() {
+    writer.stop();
+}
+
+void OfflineRender::FrameWriter::setup() {
+    if (!isThreadRunning()) {
+        startThread();
+    }
+}
+
+void OfflineRender::FrameWriter::stop() {
+    // A closed channel drops whatever is still queued, so let the worker catch up first
+    while (pending > 0 && isThreadRunning()) {
+        ofSleepMillis(1);
+    }
+    frames.close();
+    if (isThreadRunning()) {
+        waitForThread(true);
+    }
+}
+
+void OfflineRender::FrameWriter::write(const std::string &path, ofPixels &pixels) {
+    pending++;
+    frames.send(std::make_pair(path, std::move(pixels)));
+}
+
+void OfflineRender::FrameWriter::threadedFunction() {
+    std::pair<std::string, ofPixels> frame;
+    while (frames.receive(frame)) {
+        if (!ofSaveImage(frame.second, frame.first)) {
+            ofLogError("OfflineRender") << "Can't write " << frame.first;
+            failed++;
+        }
+        pending--;
+    }
+}
@@ -0,0 +1,93 @@
+//
+//  OfflineRender.hpp
+//  visual-soundfx-test2
+//
+//  Command-line mode that pushes a clip (or a folder of images) through the effect chain as
+//  fast as it can and writes every frame to disk - for benchmarks and regression checks on
+//  machines without a display. Time runs at a fixed step per frame and all randomness comes
+//  from --seed, so the same input and arguments give the same frames.
+//
+//    visual-soundfx-test2 --render videos/clip.mov --effects motionblur,fisheye --out render
+//
+//  Options: --effects a,b (chain order, default motionblur), --out dir (under data/, default
+//  render), --seed n (default 1), --frames n (0 = all), --size WxH (default 1280x720),
+//  --fps n (fixed time step, default 25), --format png|jpg|bmp (default png).
+//
+//  The source pixels are decoded on the CPU and fed straight to the CPU effects as RGBA, so
+//  apart from the chain's FBOs nothing needs more than a software GL context. A motionblur
+//  render where no frame comes out different from its source fails.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "EffectStages.hpp"
+
+class OfflineRender : public ofBaseApp {
+public:
+    struct Settings {
+        std::string input;
+        std::string outputDir = "render";
+        std::vector<std::string> effects = {"motionblur"};
+        uint64_t seed = 1;
+        int maxFrames = 0;
+        int width = 1280;
+        int height = 720;
+        float fps = 25.0f;
+        std::string format = "png";
+    };
+
+    // True if the arguments ask for an offline render (settings filled in), false to run normally
+    static bool parseArguments(int argc, char *argv[], Settings &settings);
+
+    OfflineRender(const Settings &_settings) : settings(_settings) {}
+
+    void setup() override;
+    void update() override;
+    void draw() override;
+    void exit() override;
+
+private:
+    // Encodes and saves frames on a worker thread so PNG compression doesn't hold up the chain
+    class FrameWriter : public ofThread {
+    public:
+        void setup();
+        void stop();
+        void write(const std::string &path, ofPixels &pixels);   // takes the pixels
+        int getPending() const { return pending; }
+        int getFailed() const { return failed; }
+    private:
+        void threadedFunction() override;
+        ofThreadChannel<std::pair<std::string, ofPixels>> frames;
+        std::atomic<int> pending{0};
+        std::atomic<int> failed{0};
+    };
+
+    bool openSource();
+    bool readFrame(ofPixels &pixels);    // next source frame at the render size
+    bool differsFromSource(const ofPixels &output) const;   // RGB only, output's alpha is dropped
+    void finish(bool success);
+
+    Settings settings;
+
+    // Source - a video decoded without a texture, or a sorted list of image files
+    ofVideoPlayer video;
+    std::vector<std::string> imagePaths;
+    int totalFrames = 0;
+
+    MotionBlur motionBlur;
+    StepPrinting stepPrinting;
+    GlitchEffect glitchEffect;
+    FisheyeLens fisheye;
+    EffectChain effectChain;
+
+    ofPixels sourcePixels;
+    ofTexture sourceTexture;
+    ofPixels outputPixels;
+    FrameWriter writer;
+
+    int framesRendered = 0;
+    bool outputChanged = false;     // some frame after the first came out different from its source
+    bool finished = false;
+    std::chrono::steady_clock::time_point startTime; // real time - ofGetElapsedTime* runs on the fixed step
+};
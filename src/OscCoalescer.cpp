@@ -0,0 +1,175 @@
+//
+//  OscCoalescer.cpp
+//  visual-soundfx-test2
+//
+
+#include "OscCoalescer.hpp"
+
+void OscCoalescer::push(const ofxOscMessage &message) {
+    const std::string &address = message.getAddress();
+    push(OscRouter::hash(address), address.c_str(), OscRouter::getArgAsFloat(message), OscRouter::getArgAsInt(message));
+}
+
+void OscCoalescer::push(uint32_t addressHash, const char *address, float floatValue, int intValue) {
+    received++;
+    int index = findSlot(addressHash, address);
+    Slot &slot = slots[index];
+
+    if (slot.passthrough) {
+        triggers.push_back({index, floatValue, intValue, sequence++});
+    } else {
+        if (slot.pending) {
+            // Only the latest value per frame matters
+            droppedDuplicates++;
+            droppedThisFrame++;
+        } else {
+            slot.pending = true;
+            pendingSlots.push_back(index);
+        }
+        if (!slot.hasValue) {
+            slot.current = floatValue; // nothing to smooth from yet
+            slot.hasValue = true;
+        }
+        slot.target = floatValue;
+        slot.intValue = intValue;
+        slot.sequence = sequence++;
+    }
+
+    maxQueueDepth = std::max(maxQueueDepth, getQueueDepth());
+}
+
+void OscCoalescer::flush(OscRouter &router, float deltaTime) {
+    // Values go out in the order their latest message arrived, interleaved with the triggers
+    std::sort(pendingSlots.begin(), pendingSlots.end(), [this](int a, int b) {
+        return slots[a].sequence < slots[b].sequence;
+    });
+
+    size_t nextTrigger = 0;
+    auto dispatchTriggersBefore = [&](uint64_t before) {
+        while (nextTrigger < triggers.size() && triggers[nextTrigger].sequence < before) {
+            const Trigger &trigger = triggers[nextTrigger++];
+            const Slot &slot = slots[trigger.slot];
+            router.dispatch(slot.hash, slot.address, trigger.floatValue, trigger.intValue);
+            dispatched++;
+        }
+    };
+
+    for (int index : pendingSlots) {
+        Slot &slot = slots[index];
+        dispatchTriggersBefore(slot.sequence);
+        slot.pending = false;
+
+        if (slot.timeConstant > 0) {
+            // Dispatched by the smoothing pass below
+            if (!slot.settling) {
+                slot.settling = true;
+                settlingSlots.push_back(index);
+            }
+            continue;
+        }
+
+        slot.current = slot.target;
+        router.dispatch(slot.hash, slot.address, slot.current, slot.intValue);
+        dispatched++;
+    }
+    dispatchTriggersBefore(UINT64_MAX);
+
+    // Ease smoothed addresses towards their targets, frame rate independent
+    settlingSlots.erase(std::remove_if(settlingSlots.begin(), settlingSlots.end(), [&](int index) {
+        Slot &slot = slots[index];
+        float blend = slot.timeConstant > 0 ? 1.0f - expf(-deltaTime / slot.timeConstant) : 1.0f;
+        slot.current += (slot.target - slot.current) * blend;
+
+        bool settled = fabsf(slot.target - slot.current) <= 1e-4f * std::max(1.0f, fabsf(slot.target));
+        if (settled) {
+            slot.current = slot.target;
+            slot.settling = false;
+        }
+        router.dispatch(slot.hash, slot.address, slot.current, slot.intValue);
+        dispatched++;
+        return settled;
+    }), settlingSlots.end());
+
+    pendingSlots.clear();
+    triggers.clear();
+    droppedLastFrame = droppedThisFrame;
+    droppedThisFrame = 0;
+}
+
+void OscCoalescer::setPassthrough(const std::string &pattern, bool enabled) {
+    passthroughPatterns.push_back(std::make_pair(pattern, enabled));
+    for (auto &slot : slots) {
+        configureSlot(slot);
+    }
+}
+
+void OscCoalescer::setSmoothing(const std::string &pattern, float timeConstant) {
+    smoothingPatterns.push_back(std::make_pair(pattern, std::max(0.0f, timeConstant)));
+    for (auto &slot : slots) {
+        configureSlot(slot);
+    }
+}
+
+int OscCoalescer::getQueueDepth() const {
+    return pendingSlots.size() + triggers.size();
+}
+
+int OscCoalescer::getMaxQueueDepth() const {
+    return maxQueueDepth;
+}
+
+int OscCoalescer::getDroppedLastFrame() const {
+    return droppedLastFrame;
+}
+
+uint64_t OscCoalescer::getDroppedDuplicates() const {
+    return droppedDuplicates;
+}
+
+uint64_t OscCoalescer::getReceivedCount() const {
+    return received;
+}
+
+uint64_t OscCoalescer::getDispatchedCount() const {
+    return dispatched;
+}
+
+int OscCoalescer::findSlot(uint32_t addressHash, const char *address) {
+    auto found = slotIndex.find(addressHash);
+    if (found != slotIndex.end() && slots[found->second].address == address) {
+        return found->second;
+    }
+    if (found != slotIndex.end()) {
+        // Hash collision, fall back to a search (the map keeps the first address)
+        for (int i = 0; i < (int)slots.size(); i++) {
+            if (slots[i].address == address) return i;
+        }
+    }
+
+    Slot slot;
+    slot.address = address;
+    slot.hash = addressHash;
+    configureSlot(slot);
+    slots.push_back(slot);
+
+    int index = slots.size() - 1;
+    if (found == slotIndex.end()) slotIndex[addressHash] = index;
+    return index;
+}
+
+// Later patterns override earlier ones
+void OscCoalescer::configureSlot(Slot &slot) const {
+    slot.passthrough = false;
+    for (const auto &pattern : passthroughPatterns) {
+        if (OscRouter::matchPattern(pattern.first.c_str(), slot.address.c_str())) {
+            slot.passthrough = pattern.second;
+        }
+    }
+
+    slot.timeConstant = 0;
+    for (const auto &pattern : smoothingPatterns) {
+        if (OscRouter::matchPattern(pattern.first.c_str(), slot.address.c_str())) {
+            slot.timeConstant = pattern.second;
+        }
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  OscCoalescer.hpp
+//  visual-soundfx-test2
+//
+//  Sits between the OSC receiver and the OscRouter. Continuous parameters only need their
+//  latest value each frame, so repeated messages for an address are folded into one before
+//  being dispatched - a burst from the audio host costs one handler call per address instead
+//  of one per message. Trigger addresses (activate, advance) can opt out and are passed on
+//  one by one, in order.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "OscRouter.hpp"
+
+class OscCoalescer {
+public:
+    // Queues a message for the next flush
+    void push(const ofxOscMessage &message);
+    // Same, for a value already taken out of its message
+    void push(uint32_t addressHash, const char *address, float floatValue, int intValue);
+
+    // Dispatches what's queued (and any smoothing still in progress), call once per frame
+    void flush(OscRouter &router, float deltaTime);
+
+    // Addresses matching the pattern are never coalesced, every message gets dispatched
+    void setPassthrough(const std::string &pattern, bool enabled = true);
+    // Eases towards the latest value instead of jumping, 63% of the way after timeConstant
+    // seconds (0 = off). The handler is called every frame until the value settles
+    void setSmoothing(const std::string &pattern, float timeConstant);
+
+    int getQueueDepth() const;            // messages waiting for the next flush, after coalescing
+    int getMaxQueueDepth() const;
+    int getDroppedLastFrame() const;      // duplicates folded away in the last flushed frame
+    uint64_t getDroppedDuplicates() const;
+    uint64_t getReceivedCount() const;
+    uint64_t getDispatchedCount() const;
+
+private:
+    // One per address ever seen
+    struct Slot {
+        std::string address;
+        uint32_t hash = 0;
+        bool passthrough = false;
+        float timeConstant = 0;
+        float target = 0;
+        float current = 0;
+        int intValue = 0;
+        bool hasValue = false;
+        bool pending = false;    // has a new value this frame
+        bool settling = false;   // smoothing hasn't reached the target yet
+        uint64_t sequence = 0;   // when the latest value arrived, keeps dispatch in arrival order
+    };
+
+    // Passthrough messages keep every value
+    struct Trigger {
+        int slot;
+        float floatValue;
+        int intValue;
+        uint64_t sequence;
+    };
+
+    int findSlot(uint32_t addressHash, const char *address);
+    void configureSlot(Slot &slot) const;
+
+    std::vector<Slot> slots;
+    std::unordered_map<uint32_t, int> slotIndex;
+    std::vector<int> pendingSlots;        // slots to dispatch at the next flush
+    std::vector<Trigger> triggers;
+    std::vector<int> settlingSlots;
+
+    std::vector<std::pair<std::string, bool>> passthroughPatterns;
+    std::vector<std::pair<std::string, float>> smoothingPatterns;
+
+    uint64_t sequence = 0;
+    uint64_t received = 0;
+    uint64_t dispatched = 0;
+    uint64_t droppedDuplicates = 0;
+    int droppedThisFrame = 0;
+    int droppedLastFrame = 0;
+    int maxQueueDepth = 0;
+};
@@ -0,0 +1,132 @@
+//
+//  OscEventReceiver.cpp
+//  visual-soundfx-test2
+//
+
+#include "OscEventReceiver.hpp"
+#include "OscRouter.hpp"
+
+namespace {
+    const char *loopbackAddress = "/test/loopback";
+}
+
+OscEventReceiver::OscEventReceiver() : events(4096), dropped(0) {
+}
+
+void OscEventReceiver::ProcessMessage(const osc::ReceivedMessage &message, const osc::IpEndpointName &remoteEndpoint) {
+    OscEvent event;
+    event.receivedMicros = ofGetElapsedTimeMicros();
+
+    const char *address = message.AddressPattern();
+    size_t length = strlen(address);
+    if (length >= sizeof(event.address)) {
+        dropped++;
+        return;
+    }
+    memcpy(event.address, address, length + 1);
+    event.hash = OscRouter::hash(address);
+
+    // Same conversions as OscRouter::getArgAsFloat/getArgAsInt
+    event.floatValue = 0;
+    event.intValue = 0;
+    event.sentMicros = 0;
+    osc::ReceivedMessageArgumentIterator arg = message.ArgumentsBegin();
+    if (arg != message.ArgumentsEnd()) {
+        if (arg->IsFloat()) {
+            event.floatValue = arg->AsFloatUnchecked();
+            event.intValue = (int32_t)event.floatValue;
+        } else if (arg->IsInt32()) {
+            event.intValue = arg->AsInt32Unchecked();
+            event.floatValue = (float)event.intValue;
+        } else if (arg->IsDouble()) {
+            event.floatValue = (float)arg->AsDoubleUnchecked();
+            event.intValue = (int32_t)event.floatValue;
+        } else if (arg->IsTrue() || arg->IsFalse()) {
+            event.intValue = arg->IsTrue() ? 1 : 0;
+            event.floatValue = (float)event.intValue;
+        }
+
+        ++arg;
+        if (arg != message.ArgumentsEnd() && arg->IsInt64()) {
+            event.sentMicros = arg->AsInt64Unchecked();
+        }
+    }
+
+    if (!events.push(event)) {
+        dropped++; // main loop has fallen too far behind, drop rather than block the socket
+    }
+}
+
+bool OscEventReceiver::pop(OscEvent &event) {
+    if (!events.pop(event)) return false;
+
+    uint64_t now = ofGetElapsedTimeMicros();
+    uint64_t waited = now > event.receivedMicros ? now - event.receivedMicros : 0;
+    poppedCount++;
+    totalQueueLatency += waited;
+    maxQueueLatency = std::max(maxQueueLatency, waited);
+
+    if (event.sentMicros != 0 && strcmp(event.address, loopbackAddress) == 0) {
+        uint64_t latency = now > event.sentMicros ? now - event.sentMicros : 0;
+        loopbackCount++;
+        totalLoopbackLatency += latency;
+        maxLoopbackLatency = std::max(maxLoopbackLatency, latency);
+    }
+    return true;
+}
+
+size_t OscEventReceiver::getQueueDepth() const {
+    return events.size();
+}
+
+uint64_t OscEventReceiver::getDroppedCount() const {
+    return dropped.load();
+}
+
+double OscEventReceiver::getAverageQueueLatency() const {
+    return poppedCount > 0 ? (double)totalQueueLatency / poppedCount : 0;
+}
+
+uint64_t OscEventReceiver::getMaxQueueLatency() const {
+    return maxQueueLatency;
+}
+
+int OscEventReceiver::getLoopbackCount() const {
+    return loopbackCount;
+}
+
+double OscEventReceiver::getAverageLoopbackLatency() const {
+    return loopbackCount > 0 ? (double)totalLoopbackLatency / loopbackCount : 0;
+}
+
+uint64_t OscEventReceiver::getMaxLoopbackLatency() const {
+    return maxLoopbackLatency;
+}
+
+void OscEventReceiver::resetLatency() {
+    poppedCount = 0;
+    totalQueueLatency = 0;
+    maxQueueLatency = 0;
+    loopbackCount = 0;
+    totalLoopbackLatency = 0;
+    maxLoopbackLatency = 0;
+}
+
+void OscEventReceiver::sendLoopbackBurst(int count) {
+    if (!loopbackSenderReady) {
+        loopbackSenderReady = loopbackSender.setup("127.0.0.1", getPort());
+        if (!loopbackSenderReady) {
+            ofLogError("OscEventReceiver") << "Couldn't open loopback sender to port " << getPort();
+            return;
+        }
+    }
+
+    ofxOscMessage message;
+    for (int i = 0; i < count; i++) {
+        message.clear();
+        message.setAddress(loopbackAddress);
+        message.addFloatArg(i);
+        message.addInt64Arg(ofGetElapsedTimeMicros());
+        loopbackSender.sendMessage(message, false);
+    }
+}
@@ -0,0 +1,72 @@
+//
+//  OscEventReceiver.hpp
+//  visual-soundfx-test2
+//
+//  ofxOscReceiver already listens on its own thread. This turns each message into a small
+//  timestamped OscEvent right there on the listener thread and hands it to the render loop
+//  through a lock-free SpscQueue, so nothing is parsed or allocated per message on the main
+//  thread and no lock is shared with it.
+//
+//  Loopback test: send "/test/loopback" to this port with the sender's ofGetElapsedTimeMicros()
+//  as an int64 second argument (see sendLoopbackBurst) and the send-to-consume latency is measured.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+#include "SpscQueue.hpp"
+
+struct OscEvent {
+    uint32_t hash;            // OscRouter::hash of the address
+    char address[64];
+    float floatValue;         // first argument, converted whichever numeric type it was
+    int32_t intValue;
+    uint64_t receivedMicros;  // ofGetElapsedTimeMicros() on the listener thread
+    uint64_t sentMicros;      // optional int64 second argument from the sender, 0 if absent
+};
+
+class OscEventReceiver : public ofxOscReceiver {
+public:
+    OscEventReceiver();
+    // ~ofxOscReceiver only stops the listener once our members are gone, and a message landing
+    // in between would be pushed into a freed queue - so stop it while they're still here
+    ~OscEventReceiver() { stop(); }
+
+    // Main thread, never blocks. Also records how long the event waited
+    bool pop(OscEvent &event);
+
+    size_t getQueueDepth() const;
+    uint64_t getDroppedCount() const;     // ring full or address too long
+
+    // Listener thread -> main thread wait, over everything popped so far (microseconds)
+    double getAverageQueueLatency() const;
+    uint64_t getMaxQueueLatency() const;
+
+    // Sender -> main thread, for events that carried a send time (microseconds)
+    int getLoopbackCount() const;
+    double getAverageLoopbackLatency() const;
+    uint64_t getMaxLoopbackLatency() const;
+    void resetLatency();
+
+    // Sends count stamped "/test/loopback" messages to this receiver over UDP on 127.0.0.1
+    void sendLoopbackBurst(int count);
+
+protected:
+    // Called on ofxOscReceiver's listener thread for every incoming message
+    void ProcessMessage(const osc::ReceivedMessage &message, const osc::IpEndpointName &remoteEndpoint) override;
+
+private:
+    SpscQueue<OscEvent> events;
+    std::atomic<uint64_t> dropped;
+
+    // Main thread only
+    uint64_t poppedCount = 0;
+    uint64_t totalQueueLatency = 0;
+    uint64_t maxQueueLatency = 0;
+    int loopbackCount = 0;
+    uint64_t totalLoopbackLatency = 0;
+    uint64_t maxLoopbackLatency = 0;
+    ofxOscSender loopbackSender;
+    bool loopbackSenderReady = false;
+};
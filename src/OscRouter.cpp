@@ -0,0 +1,296 @@
+//
+//  OscRouter.cpp
+//  visual-soundfx-test2
+//
+
+#include "OscRouter.hpp"
+
+void OscRouter::addFloat(const std::string &pattern, FloatHandler handler) {
+    Route route;
+    route.pattern = pattern;
+    route.type = ROUTE_FLOAT;
+    route.floatHandler = handler;
+    addRoute(route);
+}
+
+void OscRouter::addInt(const std::string &pattern, IntHandler handler) {
+    Route route;
+    route.pattern = pattern;
+    route.type = ROUTE_INT;
+    route.intHandler = handler;
+    addRoute(route);
+}
+
+void OscRouter::add(const std::string &pattern, MessageHandler handler) {
+    Route route;
+    route.pattern = pattern;
+    route.type = ROUTE_MESSAGE;
+    route.messageHandler = handler;
+    addRoute(route);
+}
+
+void OscRouter::addRoute(Route route) {
+    route.isWildcard = isWildcardPattern(route.pattern);
+    routes.push_back(route);
+    resolvedAddresses.clear(); // every cached address has to be matched again
+}
+
+void OscRouter::setLogging(const std::string &pattern, bool enabled) {
+    logPatterns.push_back(std::make_pair(pattern, enabled));
+    for (auto &entry : resolvedAddresses) {
+        fillResolved(entry.second);
+    }
+}
+
+void OscRouter::setLogUnmatched(bool enabled) {
+    logUnmatched = enabled;
+}
+
+void OscRouter::setLogAll(bool enabled) {
+    logAll = enabled;
+}
+
+bool OscRouter::isLoggingAll() const {
+    return logAll;
+}
+
+bool OscRouter::dispatch(const ofxOscMessage &message) {
+    const std::string &address = message.getAddress();
+    const Resolved &resolved = resolve(hash(address), address);
+    runRoutes(resolved, getArgAsFloat(message), getArgAsInt(message), &message);
+    return !resolved.routes.empty();
+}
+
+bool OscRouter::dispatch(uint32_t addressHash, const std::string &address, float floatValue, int intValue) {
+    const Resolved &resolved = resolve(addressHash, address);
+    runRoutes(resolved, floatValue, intValue, nullptr);
+    return !resolved.routes.empty();
+}
+
+void OscRouter::runRoutes(const Resolved &resolved, float floatValue, int intValue, const ofxOscMessage *message) {
+    if (resolved.log || logAll) {
+        ofLog() << "Received OSC message: " << resolved.address << " " << floatValue;
+    }
+    if (resolved.routes.empty()) {
+        if (logUnmatched) ofLogVerbose("OscRouter") << "No route for " << resolved.address;
+        return;
+    }
+
+    for (int index : resolved.routes) {
+        const Route &route = routes[index];
+        switch (route.type) {
+            case ROUTE_FLOAT: route.floatHandler(floatValue); break;
+            case ROUTE_INT: route.intHandler(intValue); break;
+            case ROUTE_MESSAGE:
+                if (!message) {
+                    scratchMessage.clear();
+                    scratchMessage.setAddress(resolved.address);
+                    scratchMessage.addFloatArg(floatValue);
+                    message = &scratchMessage;
+                }
+                route.messageHandler(*message);
+                break;
+        }
+    }
+}
+
+float OscRouter::getArgAsFloat(const ofxOscMessage &message) {
+    if (message.getNumArgs() == 0) return 0.0f;
+    switch (message.getArgType(0)) {
+        case OFXOSC_TYPE_FLOAT: return message.getArgAsFloat(0);
+        case OFXOSC_TYPE_INT32: return (float)message.getArgAsInt32(0);
+        default: return 0.0f;
+    }
+}
+
+int OscRouter::getArgAsInt(const ofxOscMessage &message) {
+    if (message.getNumArgs() == 0) return 0;
+    switch (message.getArgType(0)) {
+        case OFXOSC_TYPE_INT32: return message.getArgAsInt32(0);
+        case OFXOSC_TYPE_FLOAT: return (int)message.getArgAsFloat(0);
+        default: return 0;
+    }
+}
+
+const OscRouter::Resolved &OscRouter::resolve(uint32_t addressHash, const std::string &address) {
+    auto found = resolvedAddresses.find(addressHash);
+    if (found != resolvedAddresses.end()) {
+        if (found->second.address == address) return found->second;
+
+        // Hash collision - resolve without caching rather than evict the other address
+        collision.address = address;
+        fillResolved(collision);
+        return collision;
+    }
+
+    Resolved &resolved = resolvedAddresses[addressHash];
+    resolved.address = address;
+    fillResolved(resolved);
+    return resolved;
+}
+
+// Matches an address against every route and logging pattern, in registration order
+void OscRouter::fillResolved(Resolved &resolved) const {
+    resolved.routes.clear();
+    for (int i = 0; i < (int)routes.size(); i++) {
+        bool matches = routes[i].isWildcard ? matchPattern(routes[i].pattern.c_str(), resolved.address.c_str())
+                                            : routes[i].pattern == resolved.address;
+        if (matches) resolved.routes.push_back(i);
+    }
+
+    // Later logging toggles override earlier ones
+    resolved.log = false;
+    for (const auto &logPattern : logPatterns) {
+        if (matchPattern(logPattern.first.c_str(), resolved.address.c_str())) {
+            resolved.log = logPattern.second;
+        }
+    }
+}
+
+uint32_t OscRouter::hash(const char *address) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)address; *c; c++) {
+        h ^= *c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint32_t OscRouter::hash(const std::string &address) {
+    return hash(address.c_str());
+}
+
+bool OscRouter::isWildcardPattern(const std::string &pattern) {
+    return pattern.find_first_of("?*[]{}") != std::string::npos;
+}
+
+// OSC 1.0 address pattern matching. Wildcards never match across a '/'
+bool OscRouter::matchPattern(const char *pattern, const char *address) {
+    while (*pattern) {
+        switch (*pattern) {
+            case '?':
+                if (!*address || *address == '/') return false;
+                pattern++;
+                address++;
+                break;
+
+            case '*': {
+                // Collapse runs of '*' then try every split within this path segment
+                while (*pattern == '*') pattern++;
+                for (const char *a = address; ; a++) {
+                    if (matchPattern(pattern, a)) return true;
+                    if (!*a || *a == '/') return false;
+                }
+            }
+
+            case '[': {
+                if (!*address || *address == '/') return false;
+                pattern++;
+                bool negate = *pattern == '!';
+                if (negate) pattern++;
+
+                bool inSet = false;
+                while (*pattern && *pattern != ']') {
+                    if (pattern[1] == '-' && pattern[2] && pattern[2] != ']') {
+                        if (*address >= pattern[0] && *address <= pattern[2]) inSet = true;
+                        pattern += 3;
+                    } else {
+                        if (*address == *pattern) inSet = true;
+                        pattern++;
+                    }
+                }
+                if (*pattern != ']' || inSet == negate) return false;
+                pattern++;
+                address++;
+                break;
+            }
+
+            case '{': {
+                // Try each comma separated alternative followed by the rest of the pattern
+                const char *close = strchr(pattern, '}');
+                if (!close) return false;
+                const char *option = pattern + 1;
+                while (option <= close) {
+                    const char *end = option;
+                    while (end < close && *end != ',') end++;
+                    size_t length = end - option;
+                    if (strncmp(option, address, length) == 0 && matchPattern(close + 1, address + length)) {
+                        return true;
+                    }
+                    option = end + 1;
+                }
+                return false;
+            }
+
+            default:
+                if (*pattern != *address) return false;
+                pattern++;
+                address++;
+                break;
+        }
+    }
+    return *address == 0;
+}
+
+OscRouter::BenchmarkResult OscRouter::benchmark(const std::vector<ofxOscMessage> &burst) {
+    BenchmarkResult result;
+    result.messages = burst.size();
+
+    uint64_t start = ofGetElapsedTimeMicros();
+    for (const auto &message : burst) {
+        if (dispatch(message)) result.matched++;
+    }
+    uint64_t elapsed = ofGetElapsedTimeMicros() - start;
+
+    result.totalMillis = elapsed / 1000.0;
+    result.nanosPerMessage = result.messages > 0 ? elapsed * 1000.0 / result.messages : 0;
+    return result;
+}
+
+std::vector<ofxOscMessage> OscRouter::loadBurst(const std::string &path, int count) {
+    std::vector<ofxOscMessage> burst;
+
+    ofFile file(path);
+    if (file.exists()) {
+        ofBuffer buffer = ofBufferFromFile(path);
+        for (const auto &line : buffer.getLines()) {
+            std::vector<std::string> parts = ofSplitString(line, " ", true, true);
+            if (parts.size() < 2) continue;
+            ofxOscMessage message;
+            message.setAddress(parts[0]);
+            message.addFloatArg(ofToFloat(parts[1]));
+            burst.push_back(message);
+        }
+        ofLog() << "Loaded OSC burst of " << burst.size() << " messages from " << path;
+        return burst;
+    }
+
+    // Mostly continuous reverb/delay parameters with the odd activation and a few unknown addresses
+    const char *addresses[] = {
+        "/reverb/roomSize", "/reverb/wetLevel", "/delay/feedback", "/delay/delayTime",
+        "/delay/mix", "/effect/reverb/activate", "/effect/delay/activate", "/meter/level"
+    };
+    const float weights[] = {0.3f, 0.3f, 0.2f, 0.1f, 0.05f, 0.01f, 0.01f, 0.03f};
+
+    ofBuffer out;
+    for (int i = 0; i < count; i++) {
+        float pick = ofRandom(1.0f);
+        int a = 0;
+        while (a < 7 && pick > weights[a]) {
+            pick -= weights[a];
+            a++;
+        }
+
+        float value = a == 3 ? ofRandom(2000.0f) : (a == 5 || a == 6) ? (float)(int)ofRandom(2.0f) : ofRandom(1.0f);
+        ofxOscMessage message;
+        message.setAddress(addresses[a]);
+        message.addFloatArg(value);
+        burst.push_back(message);
+
+        out.append(std::string(addresses[a]) + " " + ofToString(value) + "\n");
+    }
+
+    ofBufferToFile(path, out);
+    ofLog() << "Generated OSC burst of " << count << " messages, saved to " << path;
+    return burst;
+}
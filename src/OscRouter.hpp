@@ -0,0 +1,91 @@
+//
+//  OscRouter.hpp
+//  visual-soundfx-test2
+//
+//  Routing table for incoming OSC. Effects register typed handlers against address patterns
+//  (exact addresses or OSC 1.0 wildcards: ? * [abc] [a-z] [!abc] {foo,bar}). Each address is
+//  hashed once and resolved to its handlers the first time it's seen, after that a message
+//  costs one hash lookup.
+//
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxOsc.h"
+
+class OscRouter {
+public:
+    typedef std::function<void(float)> FloatHandler;
+    typedef std::function<void(int)> IntHandler;
+    typedef std::function<void(const ofxOscMessage&)> MessageHandler;
+
+    struct BenchmarkResult {
+        int messages = 0;
+        int matched = 0;          // messages that hit at least one route
+        double totalMillis = 0;
+        double nanosPerMessage = 0;
+    };
+
+    // Handlers get the first argument as float/int, or the whole message
+    void addFloat(const std::string &pattern, FloatHandler handler);
+    void addInt(const std::string &pattern, IntHandler handler);
+    void add(const std::string &pattern, MessageHandler handler);
+
+    // Runs every handler whose pattern matches, returns false if nothing did
+    bool dispatch(const ofxOscMessage &message);
+    // Same for a value that has already been taken out of its message (e.g. coalesced)
+    bool dispatch(uint32_t addressHash, const std::string &address, float floatValue, int intValue);
+
+    // Per-address logging, the pattern may use wildcards ("/reverb/*")
+    void setLogging(const std::string &pattern, bool enabled);
+    void setLogUnmatched(bool enabled);
+    void setLogAll(bool enabled);
+    bool isLoggingAll() const;
+
+    static uint32_t hash(const char *address); // FNV-1a
+    static uint32_t hash(const std::string &address);
+    static bool matchPattern(const char *pattern, const char *address);
+    
+    // First argument as a number whatever its OSC type, without ofxOsc's conversion warnings
+    static float getArgAsFloat(const ofxOscMessage &message);
+    static int getArgAsInt(const ofxOscMessage &message);
+
+    // Replays a burst through the table and times it
+    BenchmarkResult benchmark(const std::vector<ofxOscMessage> &burst);
+    // Reads "address value" lines; if the file doesn't exist a burst shaped like the audio
+    // host's traffic is generated and saved there, so later runs replay the same messages
+    static std::vector<ofxOscMessage> loadBurst(const std::string &path, int count = 10000);
+
+private:
+    enum RouteType { ROUTE_FLOAT, ROUTE_INT, ROUTE_MESSAGE };
+
+    struct Route {
+        std::string pattern;
+        bool isWildcard;
+        RouteType type;
+        FloatHandler floatHandler;
+        IntHandler intHandler;
+        MessageHandler messageHandler;
+    };
+
+    // Everything known about one address once it has been resolved
+    struct Resolved {
+        std::string address;
+        std::vector<int> routes;
+        bool log;
+    };
+
+    void addRoute(Route route);
+    const Resolved &resolve(uint32_t addressHash, const std::string &address);
+    void runRoutes(const Resolved &resolved, float floatValue, int intValue, const ofxOscMessage *message);
+    void fillResolved(Resolved &resolved) const;
+    static bool isWildcardPattern(const std::string &pattern);
+
+    std::vector<Route> routes;
+    std::vector<std::pair<std::string, bool>> logPatterns;
+    std::unordered_map<uint32_t, Resolved> resolvedAddresses;
+    Resolved collision;   // scratch entry for the (unlikely) case of two addresses sharing a hash
+    ofxOscMessage scratchMessage; // rebuilt for message handlers when dispatching a bare value
+    bool logUnmatched = true;
+    bool logAll = false;
+};
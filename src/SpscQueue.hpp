@@ -0,0 +1,60 @@
+//
+//  SpscQueue.hpp
+//  visual-soundfx-test2
+//
+//  Lock-free ring buffer for handing events from exactly one producer thread to exactly one
+//  consumer thread. Neither side ever blocks or allocates: push() fails when the ring is full
+//  and pop() fails when it's empty. Keep T small and trivially copyable.
+//
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template<typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit SpscQueue(size_t capacity = 1024) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        buffer.resize(size);
+        mask = size - 1;
+    }
+
+    // Producer thread only
+    bool push(const T &item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) > mask) return false; // full
+        buffer[h & mask] = item;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T &item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false; // empty
+        item = buffer[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called while the other side is running
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    // Kept on separate cache lines so the two threads don't fight over them
+    alignas(64) std::atomic<size_t> head{0}; // next slot to write
+    alignas(64) std::atomic<size_t> tail{0}; // next slot to read
+};
@@ -31,6 +31,10 @@ void StaticEffect::update() {
 }
 
 void StaticEffect::apply(ofVideoPlayer& video, float x, float y, float width, float height) {
+    apply(video.getTexture(), x, y, width, height);
+}
+
+void StaticEffect::apply(const ofTexture& video, float x, float y, float width, float height) {
     if (isStaticActive) {
         // Apply horizontal shift to simulate carousel effect
         ofPushMatrix();
@@ -7,6 +7,7 @@ public:
     void setup();
     void update();
     void apply(ofVideoPlayer& video, float x, float y, float width, float height);
+    void apply(const ofTexture& texture, float x, float y, float width, float height);
     void toggleStatic(bool active);
 
     bool isStaticActive;
@@ -1,54 +1,223 @@
 
 #include "StepPrint.hpp"
+#include "FrameProfiler.hpp"
 
 StepPrinting::StepPrinting() {
     stepInterval = 30;          // Capture a frame every 30 frames (adjustable)
     frameCounter = 0;          // Used to track how many frames have passed
     maxStoredFrames = 10;      // Limit of how many frames to keep in memory for blending
+    oldestFrame = 0;
+    numStoredFrames = 0;
+    frameWidth = 0;
+    frameHeight = 0;
+    compositeMode = COMPOSITE_ACCUMULATED;
+    accumulationIndex = 0;
+    capturesSinceRebuild = 0;
+    accumulationDirty = true;
+    accumulatedMaxFrames = 0;
+    accumulatedFade = 0.0f;
 }
 
 void StepPrinting::setup(int _stepInterval) { // sets up the intervals for capturing frames
     stepInterval = _stepInterval;
-    storedFrames.clear(); // Clear any previously stored frames
+    clearFrames(); // Clear any previously stored frames
+    reserveFrames(maxStoredFrames);
+    setupAccumulation();
 }
 
 void StepPrinting::update(const ofTexture &videoTexture) {
+    PROFILE_SCOPE("steps update");
     frameCounter++; // Increment frame counter every update
     if (!videoTexture.isAllocated()) return;
 
     // Only capture a frame at every stepInterval frames
     if (frameCounter % stepInterval == 0) {
-        ofFbo frame; // Create a new frame buffer object to store this frame
-        frame.allocate(videoTexture.getWidth(), videoTexture.getHeight());
-        frame.begin();
-        videoTexture.draw(0, 0); // Draw current video texture into the FBO
-        frame.end();
+        // Slots are only (re)allocated when the video size changes
+        reserveFrames(maxStoredFrames);
+        if (videoTexture.getWidth() != frameWidth || videoTexture.getHeight() != frameHeight) {
+            allocateFrames(videoTexture.getWidth(), videoTexture.getHeight());
+        }
         
-        storedFrames.push_back(frame);
+        // Update the running sum before the oldest frame's slot gets overwritten
+        bool evictOldest = numStoredFrames >= maxStoredFrames;
+        if (compositeMode == COMPOSITE_ACCUMULATED && !accumulationDirty) {
+            accumulateCapture(videoTexture, evictOldest, evictOldest ? numStoredFrames : numStoredFrames + 1);
+        }
         
-        // Limits number of stored frames to avoid memory buildup
-        while (storedFrames.size() > maxStoredFrames) {
-            storedFrames.erase(storedFrames.begin());
+        // Write into the slot after the newest frame - once full that evicts the oldest one
+        int capacity = storedFrames.size();
+        int slot = (oldestFrame + numStoredFrames) % capacity;
+        if (numStoredFrames < maxStoredFrames) {
+            numStoredFrames++;
+        } else {
+            oldestFrame = (oldestFrame + 1) % capacity;
+        }
+        
+        storedFrames[slot].begin();
+        ofClear(0, 0, 0, 0);
+        videoTexture.draw(0, 0); // Draw current video texture into the preallocated FBO
+        storedFrames[slot].end();
+        FrameProfiler::get().countFrameCopy();
+    }
+}
+
+void StepPrinting::reserveFrames(int capacity) {
+    if (capacity <= (int)storedFrames.size()) return;
+    
+    // Rotate so the oldest frame sits at index 0, then the new slots go after the newest
+    std::rotate(storedFrames.begin(), storedFrames.begin() + oldestFrame, storedFrames.end());
+    oldestFrame = 0;
+    
+    size_t previousCapacity = storedFrames.size();
+    storedFrames.resize(capacity);
+    if (frameWidth > 0 && frameHeight > 0) {
+        for (size_t i = previousCapacity; i < storedFrames.size(); i++) {
+            storedFrames[i].allocate(frameWidth, frameHeight, GL_RGBA);
+        }
+    }
+}
+
+void StepPrinting::allocateFrames(int width, int height) {
+    frameWidth = width;
+    frameHeight = height;
+    for (auto& frame : storedFrames) {
+        frame.allocate(frameWidth, frameHeight, GL_RGBA);
+    }
+    // Float buffers so the weighted sum can go above 1 and be rescaled without clipping
+    for (auto& buffer : accumulation) {
+        buffer.allocate(frameWidth, frameHeight, GL_RGBA32F);
+    }
+    clearFrames(); // old frames don't match the new size
+}
+
+ofFbo& StepPrinting::getStoredFrame(int age) {
+    return storedFrames[(oldestFrame + age) % storedFrames.size()];
+}
+
+float StepPrinting::getFrameWeight(int age, int maxStoredFrames, float fadeStrength) {
+    return powf(0.5f, age / (float)maxStoredFrames * fadeStrength);
+}
+
+void StepPrinting::setupAccumulation() {
+    // GLSL 1.20 to match the default GL 2.1 window, everything in pixel (rect texture) coords
+    std::string fragment = R"(
+        #version 120
+        #extension GL_ARB_texture_rectangle : enable
+        uniform sampler2DRect accumulation;
+        uniform sampler2DRect evicted;
+        uniform sampler2DRect newest;
+        uniform float evictedWeight;
+        uniform float scale;
+        uniform float newestWeight;
+        void main() {
+            vec2 pos = gl_TexCoord[0].st;
+            vec3 sum = texture2DRect(accumulation, pos).rgb;
+            sum = (sum - texture2DRect(evicted, pos).rgb * evictedWeight) * scale;
+            sum += texture2DRect(newest, pos).rgb * newestWeight;
+            gl_FragColor = vec4(sum, 1.0);
         }
+    )";
+    
+    if (!ofGetUsingArbTex() ||
+        !accumulateShader.setupShaderFromSource(GL_FRAGMENT_SHADER, fragment) || !accumulateShader.linkProgram()) {
+        ofLogWarning() << "StepPrinting: accumulation shader unavailable, using exact compositing";
+        compositeMode = COMPOSITE_EXACT;
+    }
+    accumulationDirty = true;
+}
+
+void StepPrinting::accumulatePass(const ofTexture& newest, float newestWeight, const ofTexture* evicted, float scale) {
+    ofFbo& source = accumulation[accumulationIndex];
+    ofFbo& target = accumulation[1 - accumulationIndex];
+    
+    target.begin();
+    ofDisableAlphaBlending(); // the shader output replaces the old sum
+    ofSetColor(255);
+    accumulateShader.begin();
+    accumulateShader.setUniformTexture("evicted", evicted ? *evicted : newest, 1);
+    accumulateShader.setUniformTexture("newest", newest, 2);
+    accumulateShader.setUniform1f("evictedWeight", evicted ? 1.0f : 0.0f);
+    accumulateShader.setUniform1f("scale", scale);
+    accumulateShader.setUniform1f("newestWeight", newestWeight);
+    source.draw(0, 0); // binds the current sum as "accumulation" on unit 0
+    accumulateShader.end();
+    ofEnableAlphaBlending();
+    target.end();
+    FrameProfiler::get().countFrameCopy();
+    
+    accumulationIndex = 1 - accumulationIndex;
+}
+
+void StepPrinting::accumulateCapture(const ofTexture& newest, bool evictOldest, int storedAfterCapture) {
+    // Rebuild from the stored frames every maxStoredFrames captures so rounding doesn't build up
+    if (accumulatedMaxFrames != maxStoredFrames || accumulatedFade != fadeStrength ||
+        capturesSinceRebuild >= maxStoredFrames) {
+        accumulationDirty = true;
+        return;
+    }
+    
+    // Index 0 is the oldest frame and weighs 1. Removing it moves every other frame one index
+    // toward 0, so each weight grows by 1 / getFrameWeight(1), i.e. is divided by powf(0.5, fadeStrength / max)
+    float scale = evictOldest ? 1.0f / getFrameWeight(1, maxStoredFrames, fadeStrength) : 1.0f;
+    float newestWeight = getFrameWeight(storedAfterCapture - 1, maxStoredFrames, fadeStrength);
+    accumulatePass(newest, newestWeight, evictOldest ? &getStoredFrame(0).getTexture() : nullptr, scale);
+    capturesSinceRebuild++;
+}
+
+void StepPrinting::rebuildAccumulation() {
+    accumulation[accumulationIndex].begin();
+    ofClear(0, 0, 0, 0);
+    accumulation[accumulationIndex].end();
+    
+    for (int i = 0; i < numStoredFrames; i++) {
+        const ofTexture& frame = getStoredFrame(i).getTexture();
+        accumulatePass(frame, getFrameWeight(i, maxStoredFrames, fadeStrength), nullptr, 1.0f);
     }
+    
+    accumulatedMaxFrames = maxStoredFrames;
+    accumulatedFade = fadeStrength;
+    capturesSinceRebuild = 0;
+    accumulationDirty = false;
 }
 
 
 void StepPrinting::apply(ofFbo& fbo) {
-    if (!isActive() || storedFrames.empty()) return;
+    if (!isActive() || numStoredFrames == 0) return;
     
     fbo.begin();
+    draw(fbo.getWidth(), fbo.getHeight());
+    fbo.end();
+}
+
+void StepPrinting::draw(float width, float height) {
+    PROFILE_SCOPE("steps draw");
+    if (!isActive() || numStoredFrames == 0) return;
+    
+    if (compositeMode == COMPOSITE_ACCUMULATED && accumulation[0].isAllocated()) {
+        // Parameters changed or the sum is due a refresh - rebuild before drawing
+        // (the accumulation FBOs nest fine inside the caller's target)
+        if (accumulationDirty || accumulatedMaxFrames != maxStoredFrames || accumulatedFade != fadeStrength) {
+            rebuildAccumulation();
+        }
+        
+        // Single additive pass of the running sum (alpha is 1 so the weights stay as summed)
+        ofEnableBlendMode(OF_BLENDMODE_ADD);
+        ofSetColor(255);
+        accumulation[accumulationIndex].draw(0, 0, width, height);
+        ofDisableBlendMode();
+        return;
+    }
+    
     //additive blending to create ghosting/motion trail effect
     ofEnableBlendMode(OF_BLENDMODE_ADD);
-    // Loop through all stored frames and draw them with decreasing alpha
-    for (size_t i = 0; i < storedFrames.size(); ++i) {
+    // Loop through all stored frames (oldest to newest) and draw them with decreasing alpha
+    for (int i = 0; i < numStoredFrames; ++i) {
         // Fade strength is based on how old the frame is
-        float alpha = 255 * powf(0.5f, i / (float)maxStoredFrames * fadeStrength);
+        float alpha = 255 * getFrameWeight(i, maxStoredFrames, fadeStrength);
         ofSetColor(255, alpha);
-        storedFrames[i].getTexture().draw(0, 0, fbo.getWidth(), fbo.getHeight());
+        getStoredFrame(i).getTexture().draw(0, 0, width, height);
     }
     ofDisableBlendMode(); // Reset blend mode to default
-    fbo.end();
 }
 bool StepPrinting::isActive() const {
     // Effect is active if more than one frame is stored and fading is enabled
@@ -58,7 +227,7 @@ bool StepPrinting::isActive() const {
 
 
 void StepPrinting::clear() {
-    storedFrames.clear();
+    clearFrames();
 }
 
 void StepPrinting::setStepInterval(int interval) {
@@ -69,29 +238,144 @@ void StepPrinting::setStepInterval(int interval) {
 void StepPrinting::setMaxStoredFrames(int maxFrames, bool forceClear) {
     // Sets the maximum number of frames to keep and clear
     maxStoredFrames = ofClamp(maxFrames, 1, 100);
-    // Clears if forced or new limit is lower than current stored frame count
-    if (forceClear || maxStoredFrames < storedFrames.size()) {
-        storedFrames.clear();
+    reserveFrames(maxStoredFrames); // only allocates when the capacity grows
+    
+    if (forceClear) {
+        clearFrames();
         frameCounter = 0;
+    } else if (numStoredFrames > maxStoredFrames) {
+        // Drop the oldest frames that no longer fit, the slots stay allocated
+        int excess = numStoredFrames - maxStoredFrames;
+        oldestFrame = (oldestFrame + excess) % storedFrames.size();
+        numStoredFrames = maxStoredFrames;
+        accumulationDirty = true;
     }
 }
 
+void StepPrinting::addOscRoutes(OscRouter &router) {
+    router.addFloat("/delay/mix", [this](float mix) {
+        setStepInterval(ofMap(mix, 0.0f, 1.0f, 1, 30)); // Map mix to step interval
+        setMaxStoredFrames(ofMap(mix, 0.0f, 1.0f, 1, 40)); // and max stored frames
+    });
+}
+
 void StepPrinting::setFadeStrength(float strength) {
     // Adjusts how quickly older frames fade out
     fadeStrength = ofClamp(strength, 0.0f, 3.0f);
 }
 
 void StepPrinting::clearFrames() {
-    // Manual frame buffer clear
-    storedFrames.clear();
+    // Manual frame buffer clear - slots stay allocated for reuse
+    oldestFrame = 0;
+    numStoredFrames = 0;
+    accumulationDirty = true;
 }
 
 void StepPrinting::resetAllParameters() {
     stepInterval = 1;  // Reset to minimum value
     maxStoredFrames = 1;
     fadeStrength = 0.0f;
-    storedFrames.clear();
+    clearFrames();
     frameCounter = 0;
 }
 
 
+
+void StepPrinting::setCompositeMode(CompositeMode mode) {
+    compositeMode = mode;
+    accumulationDirty = true; // the sum isn't maintained in exact mode
+}
+
+StepPrinting::CompositeMode StepPrinting::getCompositeMode() const {
+    return compositeMode;
+}
+
+//--------------------------------------------------------------
+StepPrintReference::StepPrintReference() {
+    maxStoredFrames = 10;
+    fadeStrength = 1.5f;
+    capturesSinceRebuild = 0;
+}
+
+void StepPrintReference::setup(int _maxStoredFrames, float _fadeStrength) {
+    maxStoredFrames = std::max(_maxStoredFrames, 1);
+    fadeStrength = _fadeStrength;
+    frames.clear();
+    accumulated.clear();
+    capturesSinceRebuild = 0;
+}
+
+void StepPrintReference::capture(const ofPixels& frame) {
+    if (!accumulated.isAllocated()) {
+        accumulated.allocate(frame.getWidth(), frame.getHeight(), OF_PIXELS_RGBA);
+        accumulated.set(0);
+    }
+    
+    bool evictOldest = (int)frames.size() >= maxStoredFrames;
+    int storedAfterCapture = evictOldest ? frames.size() : frames.size() + 1;
+    
+    // Same update as the accumulation shader: (sum - evicted) * scale + newest * newestWeight
+    float scale = evictOldest ? 1.0f / StepPrinting::getFrameWeight(1, maxStoredFrames, fadeStrength) : 1.0f;
+    float newestWeight = StepPrinting::getFrameWeight(storedAfterCapture - 1, maxStoredFrames, fadeStrength);
+    const unsigned char* evicted = evictOldest ? frames.front().getData() : nullptr;
+    const unsigned char* newest = frame.getData();
+    float* sum = accumulated.getData();
+    size_t numPixels = accumulated.getWidth() * accumulated.getHeight();
+    
+    for (size_t i = 0; i < numPixels; i++) {
+        for (int c = 0; c < 3; c++) {
+            float value = sum[i * 4 + c];
+            if (evicted) value -= evicted[i * 4 + c] / 255.0f;
+            sum[i * 4 + c] = value * scale + newest[i * 4 + c] / 255.0f * newestWeight;
+        }
+        sum[i * 4 + 3] = 1.0f;
+    }
+    
+    frames.push_back(frame);
+    if (evictOldest) frames.pop_front();
+    
+    // Matches the periodic rebuild in StepPrinting::accumulateCapture
+    if (++capturesSinceRebuild > maxStoredFrames) {
+        rebuild();
+    }
+}
+
+void StepPrintReference::rebuild() {
+    getExact(accumulated);
+    capturesSinceRebuild = 0;
+}
+
+void StepPrintReference::getExact(ofFloatPixels& result) const {
+    if (frames.empty()) return;
+    result.allocate(frames.front().getWidth(), frames.front().getHeight(), OF_PIXELS_RGBA);
+    result.set(0);
+    
+    float* sum = result.getData();
+    size_t numPixels = result.getWidth() * result.getHeight();
+    for (size_t age = 0; age < frames.size(); age++) {
+        float weight = StepPrinting::getFrameWeight(age, maxStoredFrames, fadeStrength);
+        const unsigned char* frame = frames[age].getData();
+        for (size_t i = 0; i < numPixels; i++) {
+            for (int c = 0; c < 3; c++) {
+                sum[i * 4 + c] += frame[i * 4 + c] / 255.0f * weight;
+            }
+            sum[i * 4 + 3] = 1.0f;
+        }
+    }
+}
+
+const ofFloatPixels& StepPrintReference::getAccumulated() const {
+    return accumulated;
+}
+
+float StepPrintReference::getMaxDifference() const {
+    ofFloatPixels exact;
+    getExact(exact);
+    if (!exact.isAllocated() || exact.size() != accumulated.size()) return 0.0f;
+    
+    float maxDifference = 0.0f;
+    for (size_t i = 0; i < exact.size(); i++) {
+        maxDifference = std::max(maxDifference, std::abs(exact.getData()[i] - accumulated.getData()[i]));
+    }
+    return maxDifference;
+}
@@ -6,10 +6,17 @@
 //
 
 #include "ofMain.h"
+#include "OscRouter.hpp"
 #pragma once
 
 class StepPrinting{
 public:
+    // How stored frames are combined in apply()
+    enum CompositeMode {
+        COMPOSITE_EXACT,       // draws every stored frame with its own falloff (one pass per frame)
+        COMPOSITE_ACCUMULATED  // keeps a running weighted sum updated per capture (one pass per output frame)
+    };
+    
     StepPrinting();
     
     void setup(int _stepInterval);
@@ -26,13 +33,73 @@ public:
     void resetAllParameters();
     void clearFrames();
     void apply(ofFbo& fbo);
+    void draw(float width, float height); // same trails as apply(), into the current target
+    
+    // Delay mix from the audio host sets how choppy the stepping is
+    void addOscRoutes(OscRouter &router);
+    
+    void setCompositeMode(CompositeMode mode);
+    CompositeMode getCompositeMode() const;
+    
+    // Weight of a stored frame in the composite, age 0 = oldest - powf(0.5, age / max * fadeStrength)
+    static float getFrameWeight(int age, int maxStoredFrames, float fadeStrength);
     
 private:
-    std::vector<ofFbo> storedFrames;
+    // Accumulated mode - one shader pass: (sum - evicted) * scale + newest * newestWeight
+    void setupAccumulation();
+    void accumulatePass(const ofTexture& newest, float newestWeight, const ofTexture* evicted, float scale);
+    void accumulateCapture(const ofTexture& newest, bool evictOldest, int storedAfterCapture);
+    void rebuildAccumulation();
+    
+    void reserveFrames(int capacity);          // grows the ring, keeping stored frames in order
+    void allocateFrames(int width, int height); // (re)allocates every slot at the video size
+    ofFbo& getStoredFrame(int age);            // 0 = oldest stored frame
+    
+    std::vector<ofFbo> storedFrames; // fixed ring of preallocated slots, only grows
+    int oldestFrame;                 // ring index of the oldest stored frame
+    int numStoredFrames;             // how many slots currently hold a frame
+    int frameWidth;
+    int frameHeight;
     int stepInterval;
     int frameCounter;
     int maxStoredFrames;
     float feedbackFactor; // Dynamic factor influenced by feedback
     float fadeStrength = 1.5f; // controls how fast frames fade (lower = smoother trail)
+    
+    CompositeMode compositeMode;
+    ofShader accumulateShader;
+    ofFbo accumulation[2];      // ping-pong float buffers holding the weighted sum
+    int accumulationIndex;      // which of the two holds the current sum
+    int capturesSinceRebuild;   // float error grows with every rescale, so rebuild regularly
+    bool accumulationDirty;     // sum no longer matches the stored frames / parameters
+    int accumulatedMaxFrames;   // parameters the current sum was built with
+    float accumulatedFade;
+
+};
 
+// CPU reference of both composite modes on plain pixels (no GL context needed) so the
+// accumulated mode can be diffed against the exact falloff.
+class StepPrintReference {
+public:
+    StepPrintReference();
+    
+    void setup(int _maxStoredFrames, float _fadeStrength);
+    // Stores an RGBA frame the same way StepPrinting::update does on a capture
+    void capture(const ofPixels& frame);
+    
+    // Sum of every stored frame with its own weight (COMPOSITE_EXACT)
+    void getExact(ofFloatPixels& result) const;
+    // Running sum built incrementally on each capture (COMPOSITE_ACCUMULATED)
+    const ofFloatPixels& getAccumulated() const;
+    // Largest per-channel difference between the two, in 0-1 units
+    float getMaxDifference() const;
+    
+private:
+    void rebuild();
+    
+    std::deque<ofPixels> frames; // oldest first
+    ofFloatPixels accumulated;
+    int maxStoredFrames;
+    float fadeStrength;
+    int capturesSinceRebuild;
 };
@@ -0,0 +1,159 @@
+//
+//  TilePool.cpp
+//  visual-soundfx-test2
+//
+
+#include "TilePool.hpp"
+#include <algorithm>
+
+namespace {
+    // Index of the tile this thread is running, -1 outside one. Nested forEachTile calls run
+    // inline under it so they don't wait on themselves or share another thread's scratch
+    thread_local int currentThread = -1;
+}
+
+TilePool &TilePool::get() {
+    static TilePool pool;
+    return pool;
+}
+
+TilePool::TilePool() {
+    setThreadCount(std::max((int)std::thread::hardware_concurrency(), 1));
+}
+
+TilePool::~TilePool() {
+    stopWorkers();
+}
+
+void TilePool::setThreadCount(int count) {
+    count = std::max(count, 1);
+    if (count == threadCount && (int)workers.size() == count - 1) return;
+
+    std::lock_guard<std::mutex> runLock(runMutex);
+    stopWorkers();
+    threadCount = count;
+    ranges.reset(new TileRange[count]);
+    for (int i = 1; i < count; i++) {
+        // Starting from the current generation, the last frame handed out is already done
+        workers.emplace_back(&TilePool::workerLoop, this, i, generation);
+    }
+}
+
+void TilePool::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    stopping = false;
+}
+
+void TilePool::run(int _rows, int _tileRows, TileFunction _function, void *_context) {
+    if (_rows <= 0) return;
+    _tileRows = std::max(_tileRows, 1);
+    int tileCount = (_rows + _tileRows - 1) / _tileRows;
+    int threads = std::min(threadCount, tileCount);
+
+    if (threads <= 1 || currentThread >= 0) {
+        int thread = std::max(currentThread, 0);
+        for (int start = 0; start < _rows; start += _tileRows) {
+            _function(_context, start, std::min(start + _tileRows, _rows), thread);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(runMutex);
+
+    // Contiguous shares so neighbouring rows mostly stay on one core
+    for (int i = 0; i < threadCount; i++) {
+        int front = i < threads ? (int)((int64_t)tileCount * i / threads) : 0;
+        int back = i < threads ? (int)((int64_t)tileCount * (i + 1) / threads) : 0;
+        ranges[i].set(front, back);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(doneMutex);
+        busyWorkers = threads - 1;
+    }
+    {
+        // Handed out under the lock so a worker sees the frame and its generation together
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        function = _function;
+        context = _context;
+        rows = _rows;
+        tileRows = _tileRows;
+        participants = threads;
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    // The caller only runs out once nothing is left to steal, this waits for the last tiles in flight
+    std::unique_lock<std::mutex> lock(doneMutex);
+    done.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void TilePool::work(int thread) {
+    currentThread = thread;
+    int tile;
+    while ((tile = ranges[thread].popFront()) >= 0) {
+        int start = tile * tileRows;
+        function(context, start, std::min(start + tileRows, rows), thread);
+    }
+    // Out of our own tiles - take the last ones of the others, starting with the next thread
+    for (int i = 1; i < participants; i++) {
+        TileRange &victim = ranges[(thread + i) % participants];
+        while ((tile = victim.popBack()) >= 0) {
+            int start = tile * tileRows;
+            function(context, start, std::min(start + tileRows, rows), thread);
+        }
+    }
+    currentThread = -1;
+}
+
+void TilePool::workerLoop(int thread, uint64_t seen) {
+    while (true) {
+        bool joined;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            // Frames with fewer tiles than threads leave the last workers out
+            joined = thread < participants;
+        }
+        if (!joined) continue;
+
+        work(thread);
+
+        std::lock_guard<std::mutex> lock(doneMutex);
+        if (--busyWorkers == 0) done.notify_one();
+    }
+}
+
+int TilePool::TileRange::popFront() {
+    uint64_t current = range.load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t front = current >> 32;
+        uint32_t back = (uint32_t)current;
+        if (front >= back) return -1;
+        uint64_t next = (uint64_t)(front + 1) << 32 | back;
+        if (range.compare_exchange_weak(current, next, std::memory_order_acquire, std::memory_order_relaxed)) return front;
+    }
+}
+
+int TilePool::TileRange::popBack() {
+    uint64_t current = range.load(std::memory_order_relaxed);
+    while (true) {
+        uint32_t front = current >> 32;
+        uint32_t back = (uint32_t)current;
+        if (front >= back) return -1;
+        uint64_t next = (uint64_t)front << 32 | (back - 1);
+        if (range.compare_exchange_weak(current, next, std::memory_order_acquire, std::memory_order_relaxed)) return back - 1;
+    }
+}
@@ -0,0 +1,87 @@
+//
+//  TilePool.hpp
+//  visual-soundfx-test2
+//
+//  Persistent worker threads for the CPU pixel effects. A frame is cut into tiles of whole
+//  rows, each thread starts on its own contiguous share of tiles and steals from the back of
+//  the others' shares once it runs out, so one slow tile doesn't hold the rest up.
+//
+//  forEachTile() returns when every tile is done. The caller works on tiles too, it doesn't
+//  allocate, and a call from inside a tile just runs inline. Tile functions must only write
+//  their own rows - anything random should come from per-row/per-tile streams
+//  (GlitchRandom::rowStream), never from shared state, so the output doesn't depend on the
+//  thread count or on who ran which tile.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class TilePool {
+public:
+    static TilePool &get();
+
+    // Threads working on a frame, the caller included (1 runs every tile inline).
+    // Starts with one per core. Don't call while a frame is being processed.
+    void setThreadCount(int count);
+    int getThreadCount() const { return threadCount; }
+
+    // Calls tile(rowStart, rowEnd, thread) over [0, rows) in tiles of tileRows rows. thread is
+    // in [0, getThreadCount()) and no two tiles run on the same one at once, for scratch buffers.
+    // Called from inside a tile it runs inline with that tile's thread, so the inner and outer
+    // calls shouldn't use the same scratch.
+    template <typename F>
+    void forEachTile(int rows, int tileRows, F &&tile) {
+        // Through a plain function pointer so handing out a frame never allocates
+        run(rows, tileRows, [](void *context, int rowStart, int rowEnd, int thread) {
+            (*static_cast<typename std::remove_reference<F>::type *>(context))(rowStart, rowEnd, thread);
+        }, const_cast<void *>(static_cast<const void *>(&tile)));
+    }
+
+    ~TilePool();
+
+private:
+    using TileFunction = void (*)(void *context, int rowStart, int rowEnd, int thread);
+
+    // One thread's share of the tiles, [front, back) packed into one word so the owner
+    // (front) and thieves (back) can both take tiles with a compare-exchange
+    struct alignas(64) TileRange {
+        std::atomic<uint64_t> range{0};
+        void set(uint32_t front, uint32_t back) { range.store((uint64_t)front << 32 | back, std::memory_order_relaxed); }
+        int popFront();
+        int popBack();
+    };
+
+    TilePool();
+    void run(int rows, int tileRows, TileFunction function, void *context);
+    void work(int thread);
+    void workerLoop(int thread, uint64_t seen);
+    void stopWorkers();
+
+    int threadCount = 1;
+    std::vector<std::thread> workers;
+    std::unique_ptr<TileRange[]> ranges;
+
+    // Current frame, handed out under wakeMutex and only changed once its workers are done
+    TileFunction function = nullptr;
+    void *context = nullptr;
+    int rows = 0;
+    int tileRows = 1;
+    int participants = 0;
+
+    std::mutex runMutex;                // one frame at a time if callers ever come from two threads
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    uint64_t generation = 0;            // bumped for every frame handed out
+    bool stopping = false;
+    std::mutex doneMutex;
+    std::condition_variable done;
+    int busyWorkers = 0;
+};
@@ -1,8 +1,37 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "OfflineRender.hpp"
+#include "EffectBenchmark.hpp"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+
+	// --benchmark [results.json] times every effect at 720p/1080p/4K, see EffectBenchmark.hpp
+	EffectBenchmark::Settings benchmarkSettings;
+	if (EffectBenchmark::parseArguments(argc, argv, benchmarkSettings)) {
+		ofGLFWWindowSettings settings;
+		settings.setSize(1280, 720);
+		settings.visible = false;
+
+		auto window = ofCreateWindow(settings);
+
+		ofRunApp(window, make_shared<EffectBenchmark>(benchmarkSettings));
+		return ofRunMainLoop();
+	}
+
+	// --render <clip or image folder> processes the footage offline instead, see OfflineRender.hpp
+	OfflineRender::Settings renderSettings;
+	if (OfflineRender::parseArguments(argc, argv, renderSettings)) {
+		// Hidden window, only there for the GL context (a software one is enough)
+		ofGLFWWindowSettings settings;
+		settings.setSize(renderSettings.width, renderSettings.height);
+		settings.visible = false;
+
+		auto window = ofCreateWindow(settings);
+
+		ofRunApp(window, make_shared<OfflineRender>(renderSettings));
+		return ofRunMainLoop();
+	}
 
 	//Use ofGLFWWindowSettings for more options like multi-monitor fullscreen
 	ofGLWindowSettings settings;
@@ -7,6 +7,8 @@ void ofApp::setup(){
     // Set to full screen mode
      //ofSetFullscreen(true);
     
+    FrameProfiler::get().setup(); // off until 'p'
+    
     chronologyManager.setup();
     
  motionBlur.setup(1.0f, 0.6f);
@@ -17,7 +19,7 @@ void ofApp::setup(){
     fisheye.setup(1.5f);
     
     // In setup
-    glitchEffect.setup(20, 10.0f, 0.5f);
+    glitchEffect.setup();
 
 
     
@@ -26,12 +28,19 @@ void ofApp::setup(){
     // Listen for OSC messages on port 9000
     oscReceiver.setup(9000);
     ofLog() << "Listening for OSC messages on port 9000...";
+    setupOscRoutes();
 
 
-    videoFbo.allocate(standardWidth, standardHeight, GL_RGBA);
-    videoFbo.begin();
-    ofClear(0, 0, 0, 255);
-    videoFbo.end();
+    frameReadback.setup();
+    
+    // CPU stages first - they work from the source frame, the GPU ones from their input
+    effectChain.allocate(standardWidth, standardHeight);
+    allocateVideoFbo();
+    effectChain.addStage(std::make_unique<MotionBlurStage>(motionBlur));
+    effectChain.addStage(std::make_unique<GlitchStage>(glitchEffect));
+    effectChain.addStage(std::make_unique<StepPrintingStage>(stepPrinting));
+    effectChain.addStage(std::make_unique<FisheyeStage>(fisheye));
+    ofLog() << "Effect chain: " << effectChain.describe() << ", CPU effects on " << TilePool::get().getThreadCount() << " threads";
     
     
 
@@ -39,47 +48,66 @@ void ofApp::setup(){
 
 //--------------------------------------------------------------
 void ofApp::update() {
+    FrameProfiler::get().nextFrame();
+    PROFILE_SCOPE("update");
+    
     // Update the Chronology Manager
     chronologyManager.update();
     
     // Only update effects for the main video
     ofVideoPlayer* currentVideo = chronologyManager.getCurrentVideo();
     
-    if (currentVideo && currentVideo->isFrameNew()) {
+    bool newFrame = currentVideo && isCurrentFrameNew(*currentVideo);
+    if (newFrame) {
+        // Archive clips come in all sizes, the source frame follows the clip's resolution
+        // (or the loop cache's, it may have scaled the frames down)
+        const LoopFrameCache &loopCache = chronologyManager.getLoopCache();
+        if (loopCache.isPlaying()) {
+            effectChain.setSourceSize(loopCache.getWidth(), loopCache.getHeight());
+        } else {
+            effectChain.setSourceSize(currentVideo->getWidth(), currentVideo->getHeight());
+        }
+        videoFboStale = true;
+    }
+    
+    // Last frame's readback, mapped whether or not a new video frame comes in this time
+    frameReadback.poll();
+    
+    // With no effect on draw() shows the video itself, and GPU-only chains can sample the
+    // decoder's texture - videoFbo is only filled for the CPU effects' readback or to scale down
+    bool chainActive = currentVideo && effectChain.hasEnabledStages();
+    chainReadsVideo = chainActive && canChainReadVideo(*currentVideo);
+    if (chainActive && !chainReadsVideo && videoFboStale) {
+        allocateVideoFbo();
+        
+        PROFILE_GPU_SCOPE("video upload");
         videoFbo.begin();
         ofClear(0, 0, 0, 255);
-        currentVideo->draw(0, 0, standardWidth, standardHeight);
+        drawCurrentFrame(*currentVideo, 0, 0, videoFbo.getWidth(), videoFbo.getHeight());
         videoFbo.end();
+        FrameProfiler::get().countFrameCopy();
+        videoFboStale = false;
         
-        if (isReverbActive) {
-            motionBlur.update(videoFbo.getTexture());
-        } else if (isStepActive) {
-            stepPrinting.update(videoFbo.getTexture());
-        } else if (isFisheyeActive) {
-            fisheye.update(videoFbo.getTexture());
-        } else if (isGlitchActive) {
-            glitchEffect.update(videoFbo.getTexture());
+        // One readback per new frame shared by the CPU effects (pixels arrive on the next poll)
+        if (effectChain.needsSourcePixels()) {
+            frameReadback.update(videoFbo.getTexture());
         }
     }
     
+    // Content-driven stages only do work on a new video frame (the CPU ones on new readback
+    // pixels), time-driven ones (fisheye) every frame
+    bool newPixels = frameReadback.isFrameReady() && frameReadback.getFrameNumber() != readbackFrameUsed;
+    readbackFrameUsed = frameReadback.getFrameNumber();
+    if (chainActive) {
+        effectChain.update(chainSource(*currentVideo), frameReadback.isFrameReady() ? &frameReadback.getPixels() : nullptr, newFrame, newPixels);
+    }
+    
     // Update split screen video if active (but no effects needed)
     if (chronologyManager.isSplitScreenActive && !chronologyManager.splitScreenClips.empty()) {
         chronologyManager.splitScreenClips[chronologyManager.currentSplitIndex].video.update();
     }
     
     
-    if (isMotionBlurActive) {
-        motionBlur.update(videoFbo.getTexture());
-    } else if (isStepActive) {
-        stepPrinting.update(videoFbo.getTexture());
-    } else if (isFisheyeActive) {
-        fisheye.update(videoFbo.getTexture());
-    } else if (isGlitchActive) {
-        glitchEffect.update(videoFbo.getTexture());
-    }
-    
-    
-    
     //       // Check and update effects, including Motion Blur and Step Printing
     //       if (video.isFrameNew() && isReverbActive) {
     //           motionBlur.update(video);
@@ -107,138 +135,88 @@ void ofApp::update() {
     //     }
     //
     
-    //receive and check for incoming OSC messages
-    while (oscReceiver.hasWaitingMessages()) {
-        ofxOscMessage m; // Create an OSC message object
-        oscReceiver.getNextMessage(m); // Retrieve the next OSC message
-        
-        // Log the OSC message for debugging
-        ofLog() << "Received OSC message: " << m.getAddress();
-        
-        // Check if the message relates to the reverb effect
-        if (m.getAddress() == "/reverb/roomSize" || m.getAddress() == "/reverb/wetLevel") {
-            float value = m.getArgAsFloat(0); // get  value from the OSC message
-            isReverbActive = value > 0.0f;   // Determine if reverb should be active based on the value
-            
-            // Adjust  motion blur  based on the OSC message parameters
-            if (m.getAddress() == "/reverb/roomSize") {
-                // Map  room size value to blend factor range and apply it
-                motionBlur.setBlendFactor(ofMap(value, 0.0f, 1.0f, 0.1f, 2.0f));
-            } else if (m.getAddress() == "/reverb/wetLevel") {
-                // Map  wet level value to stretch amount range and apply it
-                motionBlur.setStretchAmount(ofMap(value, 0.0f, 1.0f, 0.1f, 1.5f));
-            }
+    //take the OSC events parsed on the receiver thread, only the latest value per address goes on to the effects' routes
+    PROFILE_SCOPE("osc");
+    OscEvent event;
+    while (oscReceiver.pop(event)) {
+        if (event.hash == loopbackHash) continue; // only there for the latency measurement
+        oscCoalescer.push(event.hash, event.address, event.floatValue, event.intValue);
+    }
+    oscCoalescer.flush(oscRouter, ofGetLastFrameTime());
+    
+    if (loopbackSent > 0 && (oscReceiver.getLoopbackCount() >= loopbackSent || ofGetElapsedTimeMillis() - loopbackStartTime > 2000)) {
+        ofLog() << "OSC loopback: " << oscReceiver.getLoopbackCount() << "/" << loopbackSent << " received, send to consume avg "
+                << oscReceiver.getAverageLoopbackLatency() / 1000.0 << " ms, max " << oscReceiver.getMaxLoopbackLatency() / 1000.0
+                << " ms (queue wait avg " << oscReceiver.getAverageQueueLatency() / 1000.0 << " ms, "
+                << oscReceiver.getDroppedCount() << " dropped)";
+        loopbackSent = 0;
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::setupOscRoutes() {
+    // Reverb: any parameter above zero switches the effect on, the values drive the motion blur
+    oscRouter.addFloat("/reverb/{roomSize,wetLevel}", [this](float value) {
+        effectChain.setEnabled("motionblur", value > 0.0f);
+    });
+    
+    // Delay: delayTime/feedback drive the motion blur, mix drives step printing
+    motionBlur.addOscRoutes(oscRouter);
+    stepPrinting.addOscRoutes(oscRouter);
+    
+    // effects activation logic
+    oscRouter.addInt("/effect/reverb/activate", [this](int value) {
+        effectChain.setEnabled("motionblur", value == 1); // Activate reverb
+        if (value == 1) isDelayActive = false; // Deactivate conflicts
+    });
+    oscRouter.addInt("/effect/delay/activate", [this](int value) {
+        isDelayActive = value == 1; // Activate delay
+        if (isDelayActive) effectChain.setEnabled("motionblur", false); // Deactivate conflicts
+    });
+    
+    // Effect chain: /chain/<stage>/enable 0|1, /chain/<stage>/position n (0 = first) and
+    // /chain/<stage>/scale s (render scale, 0.5 = half the window size, 0 = match the source video)
+    oscRouter.add("/chain/*/{enable,position,scale}", [this](const ofxOscMessage& m) {
+        std::vector<std::string> parts = ofSplitString(m.getAddress(), "/", true);
+        if (parts.size() != 3) return;
+        if (parts[2] == "enable") {
+            effectChain.setEnabled(parts[1], OscRouter::getArgAsInt(m) != 0);
+        } else if (parts[2] == "scale") {
+            effectChain.setRenderScale(parts[1], OscRouter::getArgAsFloat(m));
+        } else {
+            effectChain.moveStage(parts[1], OscRouter::getArgAsInt(m));
         }
+    });
+    
+    // Check for video advancement
+    oscRouter.addInt("/video/advance", [this](int value) {
+        if (value != 1 || videos.empty()) return;
+        currentVideoIndex = (currentVideoIndex + 1) % videos.size(); // Advance to the next video
+        ofLog() << "Video advanced to index: " << currentVideoIndex;
         
-        // Check if the message relates to the delay effect
-        if (m.getAddress() == "/delay/delayTime" || m.getAddress() == "/delay/feedback") {
-            float delayValue = m.getArgAsFloat(0); // get  value from the OSC message
-            
-            // Handle delay-related messages
-            if (m.getAddress() == "/delay/delayTime") {
-                motionBlur.setBlendFactor(ofMap(delayValue, 0.0f, 2000.0f, 0.1f, 3.0f)); //map delay time to blend factor
-                
-            } else if (m.getAddress() == "/delay/feedback") {
-                motionBlur.setStretchAmount(ofMap(delayValue, 0.0f, 1.0f, 0.1f, 2.0f)); // map feedback to stretch
-                
-            }
-            
-            // Check for delay mix
-            else if (m.getAddress() == "/delay/mix") {
-                float mix = m.getArgAsFloat(0); // Get the mix value
-                stepPrinting.setStepInterval(ofMap(mix, 0.0f, 1.0f, 1, 30)); // Map mix to max stored frames
-                stepPrinting.setMaxStoredFrames(ofMap(mix, 0.0f, 1.0f, 1, 40));
-                // ofLog() << "Updated Max Stored Frames (via Mix): " << stepPrinting.getMaxStoredFrames();
+        // Stop the previous video and play the next one
+        for (int i = 0; i < videos.size(); ++i) {
+            if (i == currentVideoIndex) {
+                videos[i].play();
+            } else {
+                videos[i].stop();
             }
-            
-        }
-        
-        
-        // effects activation logic
-        
-        
-        // Check for Reverb Activation
-        if (m.getAddress() == "/effect/reverb/activate") {
-            isReverbActive = m.getArgAsInt(0) == 1; // Activate reverb
-            if (isReverbActive) isDelayActive = false; // Deactivate conflicts
         }
-        
-        // Check for Delay Activation
-        if (m.getAddress() == "/effect/delay/activate") {
-            isDelayActive = m.getArgAsInt(0) == 1; // Activate delay
-            if (isDelayActive) isReverbActive = false; // Deactivate conflicts
-        }
-        
-        // Check for video advancement
-        if (m.getAddress() == "/video/advance" && m.getArgAsInt(0) == 1) {
-            currentVideoIndex = (currentVideoIndex + 1) % videos.size(); // Advance to the next video
-            ofLog() << "Video advanced to index: " << currentVideoIndex;
-            
-            // Stop the previous video and play the next one
-            for (int i = 0; i < videos.size(); ++i) {
-                if (i == currentVideoIndex) {
-                    videos[i].play();
-                } else {
-                    videos[i].stop();
-                }
-            }
-            
-            
-            //        // Handle Reverb Parameters
-            //        if (isReverbActive && m.getAddress() == "/reverb/roomSize") {
-            //            float roomSize = m.getArgAsFloat(0);
-            //            motionBlur.setBlendFactor(ofMap(roomSize, 0.0f, 1.0f, 0.1f, 2.0f));
-            //        }
-            //
-            //        // Handle Delay Parameters
-            //        if (isDelayActive && m.getAddress() == "/delay/delayTime") {
-            //            float delayTime = m.getArgAsFloat(0);
-            //            motionBlur.setBlendFactor(ofMap(delayTime, 0.0f, 2000.0f, 0.1f, 3.0f));
-            //        }
-            //    }
-            
-            //    while (oscReceiver.hasWaitingMessages()) {
-            //        ofxOscMessage m;
-            //        oscReceiver.getNextMessage(m);
-            //        // Log the received message
-            //        ofLog() << "Received OSC message: " << m.getAddress();
-            //
-            //        // Check if the message relates to the delay effect
-            //        if (m.getAddress() == "/delay/delayTime" || m.getAddress() == "/delay/feedback") {
-            //            float delayValue = m.getArgAsFloat(0); // get  value from the OSC message
-            //
-            //            // Handle delay-related messages
-            //            if (m.getAddress() == "/delay/delayTime") {
-            //                motionBlur.setBlendFactor(ofMap(delayValue, 0.0f, 2000.0f, 0.1f, 3.0f)); //map delay time to blend factor
-            //
-            //            } else if (m.getAddress() == "/delay/feedback") {
-            //                motionBlur.setStretchAmount(ofMap(delayValue, 0.0f, 1.0f, 0.1f, 2.0f)); // map feedback to stretch
-            //
-            //            }
-            //        }
-            
-            
-            //
-            //            if (video.isFrameNew() && isReverbActive) {
-            //                motionBlur.update(video); // Always update motion blur if reverb is active
-            //            }
-            //
-            //    // Update step printing if the video frame is new
-            //    if (video.isFrameNew() && isDelayActive) {
-            //        stepPrinting.update(video);
-            //    }
-            //
-        }
-        
-        //    if (video.isFrameNew()) {
-        //          glitchEffect.update(video);  // Update the glitch effect
-        //      }
-        //}
-    }
+    });
+    
+    // Triggers have to arrive one by one, everything else is coalesced per frame
+    oscCoalescer.setPassthrough("/effect/*/activate");
+    oscCoalescer.setPassthrough("/video/advance");
+    oscCoalescer.setPassthrough("/chain/*/*");
+    
+    // The continuous parameters stream at 100+ Hz so they aren't logged unless asked for ('L')
+    oscRouter.setLogging("/effect/*/activate", true);
+    oscRouter.setLogging("/video/advance", true);
 }
     
     //--------------------------------------------------------------
 void ofApp::draw() {
+    PROFILE_SCOPE("draw");
     ofBackground(0, 0, 0);
 
     if (chronologyManager.isSplitScreenActive && !chronologyManager.isPlayingAnchor()) {
@@ -249,17 +227,12 @@ void ofApp::draw() {
         // Draw left side (main content) with effects
         ofVideoPlayer* mainVideo = chronologyManager.getCurrentVideo();
         if (mainVideo) {
-            if (isMotionBlurActive) {
-                motionBlur.apply(*mainVideo, 0, 0, halfWidth, height);
-            } else if (isStepActive) {
-                stepPrinting.apply(*mainVideo, 0, 0, halfWidth, height);
-            } else if (isFisheyeActive) {
-                fisheye.apply(0, 0, halfWidth, height);
-            } else if (isGlitchActive) {
-                glitchEffect.draw(0, 0, halfWidth, height);
+            if (effectChain.hasEnabledStages()) {
+                effectChain.render(chainSource(*mainVideo)).draw(0, 0, halfWidth, height);
             } else {
-                mainVideo->draw(0, 0, halfWidth, height);
+                drawCurrentFrame(*mainVideo, 0, 0, halfWidth, height);
             }
+            FrameProfiler::get().countFrameCopy();
         }
         
         // Draw split screen content WITHOUT effects
@@ -295,21 +268,17 @@ void ofApp::draw() {
         ofVideoPlayer* currentVideo = chronologyManager.getCurrentVideo();
         if (currentVideo) {
             if (!chronologyManager.isPlayingAnchor()) {
-                if (isReverbActive) {
-                    motionBlur.apply(*currentVideo, 0, 0, ofGetWidth(), ofGetHeight());
-                } else if (isStepActive) {
-                    stepPrinting.apply(*currentVideo, 0, 0, ofGetWidth(), ofGetHeight());
-                } else if (isFisheyeActive) {
-                    fisheye.apply(0, 0, ofGetWidth(), ofGetHeight());
-                } else if (isGlitchActive) {
-                    glitchEffect.draw(0, 0, ofGetWidth(), ofGetHeight());
+                if (effectChain.hasEnabledStages()) {
+                    // Every enabled effect stacked, in chain order
+                    effectChain.render(chainSource(*currentVideo)).draw(0, 0, ofGetWidth(), ofGetHeight());
                 } else {
-                    currentVideo->draw(0, 0, ofGetWidth(), ofGetHeight());
+                    drawCurrentFrame(*currentVideo, 0, 0, ofGetWidth(), ofGetHeight());
                 }
             } else {
                 // Anchor point - no effects
                 currentVideo->draw(0, 0, ofGetWidth(), ofGetHeight());
             }
+            FrameProfiler::get().countFrameCopy();
         }
     }
 
@@ -341,16 +310,159 @@ void ofApp::draw() {
     
     //  glitchEffect.apply(video, 0, 0, ofGetWidth(), ofGetHeight());
     
+    FrameProfiler::get().drawOverlay(10, 20);
 }
         
     
     //--------------------------------------------------------------
     void ofApp::exit(){
+        chronologyManager.exit(); // stop the clip loader thread
+        oscReceiver.stop();       // no more listener callbacks into the queue
+        
+        FrameProfiler& profiler = FrameProfiler::get();
+        if (profiler.hasData()) {
+            std::string name = "profile_" + ofGetTimestampString("%Y%m%d-%H%M%S");
+            profiler.saveCsv(name + ".csv");
+            profiler.saveChromeTrace(name + ".json");
+        }
+    }
+    
+    //--------------------------------------------------------------
+    void ofApp::windowResized(int w, int h){
+        // Output size follows the window, the stages and source frame follow the output
+        standardWidth = w;
+        standardHeight = h;
+        effectChain.allocate(w, h);
+        allocateVideoFbo();
+    }
+    
+    bool ofApp::canChainReadVideo(ofVideoPlayer &video) const {
+        // The readback wants videoFbo's RGBA layout, and a clip bigger than the output is
+        // cheaper scaled down once up front than sampled at full size by every stage
+        bool fromLoopCache = chronologyManager.getLoopCache().isPlaying();
+        if (effectChain.needsSourcePixels() || (!fromLoopCache && !video.isUsingTexture())) return false;
+        const ofTexture &texture = currentTexture(video);
+        int width, height;
+        effectChain.getScaledSize(EffectStage::matchSource, width, height);
+        return texture.isAllocated() && !texture.getTextureData().bFlipTexture && texture.getHeight() <= height;
+    }
+    
+    const ofTexture &ofApp::chainSource(ofVideoPlayer &video) {
+        // Stages draw their source at their own size, so the decoder's texture is just sampled
+        // with a different scale instead of being blitted into videoFbo first
+        return chainReadsVideo ? currentTexture(video) : videoFbo.getTexture();
+    }
+    
+    // A cached manual loop stands in for the footage decoder, which sits paused meanwhile
+    bool ofApp::isCurrentFrameNew(ofVideoPlayer &video) const {
+        const LoopFrameCache &loopCache = chronologyManager.getLoopCache();
+        return loopCache.isPlaying() ? loopCache.isFrameNew() : video.isFrameNew();
+    }
+    
+    const ofTexture &ofApp::currentTexture(ofVideoPlayer &video) const {
+        const LoopFrameCache &loopCache = chronologyManager.getLoopCache();
+        return loopCache.isPlaying() ? loopCache.getTexture() : video.getTexture();
+    }
+    
+    void ofApp::drawCurrentFrame(ofVideoPlayer &video, float x, float y, float width, float height) {
+        const LoopFrameCache &loopCache = chronologyManager.getLoopCache();
+        if (loopCache.isPlaying()) {
+            loopCache.getTexture().draw(x, y, width, height);
+        } else {
+            video.draw(x, y, width, height);
+        }
+    }
+    
+    void ofApp::allocateVideoFbo() {
+        // No point uploading the video at more than its own resolution
+        int width, height;
+        effectChain.getScaledSize(EffectStage::matchSource, width, height);
+        if (videoFbo.isAllocated() && videoFbo.getWidth() == width && videoFbo.getHeight() == height) return;
         
+        videoFbo.allocate(width, height, GL_RGBA);
+        videoFbo.begin();
+        ofClear(0, 0, 0, 255);
+        videoFbo.end();
+        ofLog() << "Source frame at " << width << "x" << height;
     }
     
     //--------------------------------------------------------------
     void ofApp::keyPressed(int key){
+        if (key == 'o') {
+            // Replays a recorded 10k message burst through the OSC routes (this does change the effect parameters)
+            std::vector<ofxOscMessage> burst = OscRouter::loadBurst("osc_burst.txt", 10000);
+            OscRouter::BenchmarkResult result = oscRouter.benchmark(burst);
+            ofLog() << "OSC burst: " << result.messages << " messages (" << result.matched << " routed) in "
+                    << result.totalMillis << " ms, " << result.nanosPerMessage << " ns per message";
+            
+            // Same burst arriving within one frame, through the coalescer
+            uint64_t dispatchedBefore = oscCoalescer.getDispatchedCount();
+            uint64_t start = ofGetElapsedTimeMicros();
+            for (const auto &message : burst) {
+                oscCoalescer.push(message);
+            }
+            int depth = oscCoalescer.getQueueDepth();
+            oscCoalescer.flush(oscRouter, ofGetLastFrameTime());
+            ofLog() << "OSC burst coalesced: " << oscCoalescer.getDispatchedCount() - dispatchedBefore << " dispatches (queue depth "
+                    << depth << ", " << oscCoalescer.getDroppedLastFrame() << " duplicates dropped) in "
+                    << (ofGetElapsedTimeMicros() - start) / 1000.0 << " ms";
+        }
+        if (key == 'u') {
+            // Latency check over UDP on 127.0.0.1, through the receiver thread and queue
+            oscReceiver.resetLatency();
+            loopbackSent = 1000;
+            loopbackStartTime = ofGetElapsedTimeMillis();
+            oscReceiver.sendLoopbackBurst(loopbackSent);
+        }
+        if (key == 'm') {
+            // Record the controller, 'M' plays the last recording back without the hardware
+            if (chronologyManager.isRecordingMidi()) {
+                chronologyManager.stopMidiRecording("midi_recording.txt");
+            } else {
+                chronologyManager.startMidiRecording();
+            }
+        }
+        if (key == 'M') {
+            chronologyManager.replayMidi("midi_recording.txt");
+        }
+        if (key == 'L') {
+            oscRouter.setLogAll(!oscRouter.isLoggingAll());
+            ofLog() << "OSC logging " << (oscRouter.isLoggingAll() ? "on" : "off");
+        }
+        
+        if (key == 'e') {
+            const EffectChain::Rates& rates = effectChain.getRates();
+            ofLog() << "Effect chain " << effectChain.describe() << ": " << rates.videoFrames << " video frames/s, "
+                    << rates.contentUpdates << " content updates/s, " << rates.timeUpdates << " time updates/s, "
+                    << rates.renders << " renders/s (" << rates.reusedRenders << " reused), "
+                    << FrameProfiler::get().getLastFrameCopies() << " full-frame copies last frame, source "
+                    << (chainReadsVideo ? (chronologyManager.getLoopCache().isPlaying() ? "loop cache texture" : "decoder texture") : "videoFbo")
+                    << ", loop cache " << chronologyManager.getLoopCache().describe();
+        }
+        if (key == 'g') {
+            // Motion blur on the CPU kernel or the shader - same parameters either way
+            motionBlur.setMode(motionBlur.getMode() == MotionBlur::MODE_GPU ? MotionBlur::MODE_CPU : MotionBlur::MODE_GPU);
+        }
+        if (key == 'p') {
+            // Profiler overlay - the timers only run while it's on
+            FrameProfiler& profiler = FrameProfiler::get();
+            profiler.setEnabled(!profiler.isEnabled());
+            profiler.setOverlayVisible(profiler.isEnabled());
+        }
+        if (key == 'P') {
+            FrameProfiler::OverheadBenchmark overhead = FrameProfiler::get().benchmarkOverhead();
+            ofLog() << "Profiler scope cost: " << overhead.disabledNanos << " ns disabled, " << overhead.enabledNanos << " ns enabled";
+        }
+        if (key == 'b') {
+            // Fisheye warp microbenchmark - lookup table vs libm on a 1080p grid
+            for (int step : {5, 10, 20, 40}) {
+                FisheyeLens::WarpBenchmark result = fisheye.benchmarkRadialLut(1920, 1080, step);
+                ofLog() << "Fisheye warp step " << result.step << " (" << result.vertices << " vertices): libm "
+                        << result.libmNanos << " ns, LUT " << result.lutNanos << " ns, speedup "
+                        << result.libmNanos / std::max(result.lutNanos, 0.001) << "x, max error " << result.maxError;
+            }
+        }
+        
         //    if (key == 's') {  // Press 's' to toggle the static effect
         //         staticEffect.toggleStatic(!staticEffect.isStaticActive);
         //     }
@@ -9,6 +9,14 @@
 #include "Glitch.hpp"
 #include "Static.hpp"
 #include "FisheyeLens.hpp"
+#include "FrameReadback.hpp"
+#include "EffectChain.hpp"
+#include "EffectStages.hpp"
+#include "FrameProfiler.hpp"
+#include "TilePool.hpp"
+#include "OscRouter.hpp"
+#include "OscCoalescer.hpp"
+#include "OscEventReceiver.hpp"
 
 //#define OSC_PORT 9000
 
@@ -21,8 +29,15 @@ class ofApp : public ofBaseApp{
         void exit() override;
 
         void keyPressed(int key) override;
+        void windowResized(int w, int h) override;
     
     void drawSplitScreen();
+    void allocateVideoFbo();    // source frame at the video's resolution, capped at the window's
+    bool canChainReadVideo(ofVideoPlayer &video) const;
+    const ofTexture &chainSource(ofVideoPlayer &video);
+    bool isCurrentFrameNew(ofVideoPlayer &video) const;
+    const ofTexture &currentTexture(ofVideoPlayer &video) const;
+    void drawCurrentFrame(ofVideoPlayer &video, float x, float y, float width, float height);
       //  void keyReleased(int key) override;
         
     
@@ -33,10 +48,21 @@ class ofApp : public ofBaseApp{
     GlitchEffect glitchEffect;
     StaticEffect staticEffect;
     
-    ofxOscReceiver oscReceiver;
+    OscEventReceiver oscReceiver;  // parses on ofxOsc's listener thread, hands over through a lock-free queue
+    OscCoalescer oscCoalescer;  // keeps the latest value per address each frame
+    OscRouter oscRouter;        // address -> effect handlers, see setupOscRoutes()
+    void setupOscRoutes();
+    const uint32_t loopbackHash = OscRouter::hash("/test/loopback");
+    int loopbackSent = 0;
+    uint64_t loopbackStartTime = 0;
     
     
     ofFbo videoFbo;
+    bool videoFboStale = true;   // a new video frame hasn't been copied in yet
+    bool chainReadsVideo = false; // the chain samples the decoder's texture, videoFbo is left alone
+    FrameReadback frameReadback; // one shared readback of videoFbo for all CPU effects
+    uint64_t readbackFrameUsed = 0; // readback the CPU effects last got
+    EffectChain effectChain;     // motionblur > glitch > steps > fisheye, each can be switched on/off
 
     int standardWidth = ofGetWidth();
     int standardHeight = ofGetHeight();
@@ -45,7 +71,6 @@ class ofApp : public ofBaseApp{
     //test commit
     //test commit 2
     
-    bool isReverbActive = false;
     bool isDelayActive = false;
     
     // Declare a vector to store the video objects
@@ -55,11 +80,6 @@ class ofApp : public ofBaseApp{
     
     ChronologyManager chronologyManager;
     FisheyeLens fisheye;
-    bool isFisheyeActive = false;
-    bool isGlitchActive = false;
-    bool isStepActive = false;
-    
-    bool isMotionBlurActive;
 
 };
 